@@ -50,6 +50,7 @@ int dbg;
 int print_delays;
 int print_io_accounting;
 int print_task_context_switch_counts;
+int print_blkio_latency_hist;
 __u64 stime, utime;
 
 #define PRINTF(fmt, arg...) {			\
@@ -73,8 +74,9 @@ char cpumask[100+6*MAX_CPUS];
 
 static void usage(void)
 {
-	fprintf(stderr, "getdelays [-dilv] [-w logfile] [-r bufsize] "
+	fprintf(stderr, "getdelays [-bdilv] [-w logfile] [-r bufsize] "
 			"[-m cpumask] [-t tgid] [-p pid]\n");
+	fprintf(stderr, "  -b: print block I/O latency histograms\n");
 	fprintf(stderr, "  -d: print delayacct stats\n");
 	fprintf(stderr, "  -i: print IO accounting (works only with -p)\n");
 	fprintf(stderr, "  -l: listen forever\n");
@@ -235,6 +237,23 @@ static void print_cgroupstats(struct cgroupstats *c)
 }
 
 
+static void print_blkio_hist(const char *name, __u64 *hist)
+{
+	int i;
+
+	printf("%-8s", name);
+	for (i = 0; i < TASKSTATS_BLKIO_LAT_BUCKETS; i++)
+		printf(" %llu", (unsigned long long)hist[i]);
+	printf("\n");
+}
+
+static void print_blkio_latency(struct taskstats *t)
+{
+	printf("\nBLKIO latency, log2 usec buckets\n");
+	print_blkio_hist("wait", t->blkio_wait_hist);
+	print_blkio_hist("service", t->blkio_service_hist);
+}
+
 static void print_ioacct(struct taskstats *t)
 {
 	printf("%s: read=%llu, write=%llu, cancelled_write=%llu\n",
@@ -270,11 +289,15 @@ int main(int argc, char *argv[])
 	struct msgtemplate msg;
 
 	while (1) {
-		c = getopt(argc, argv, "qdiw:r:m:t:p:vlC:");
+		c = getopt(argc, argv, "qbdiw:r:m:t:p:vlC:");
 		if (c < 0)
 			break;
 
 		switch (c) {
+		case 'b':
+			printf("printing block I/O latency histograms\n");
+			print_blkio_latency_hist = 1;
+			break;
 		case 'd':
 			printf("print delayacct stats ON\n");
 			print_delays = 1;
@@ -455,6 +478,8 @@ int main(int argc, char *argv[])
 							print_delayacct((struct taskstats *) NLA_DATA(na));
 						if (print_io_accounting)
 							print_ioacct((struct taskstats *) NLA_DATA(na));
+						if (print_blkio_latency_hist)
+							print_blkio_latency((struct taskstats *) NLA_DATA(na));
 						if (print_task_context_switch_counts)
 							task_context_switch_counts((struct taskstats *) NLA_DATA(na));
 						if (fd) {
@@ -0,0 +1,112 @@
+/*
+ * Measure the cost the memory controller adds to page faults.
+ *
+ * Maps an anonymous area, writes to every page of it and unmaps it, a
+ * number of times, and reports the average time per page spent in the
+ * faults, which charge the pages, and in munmap(), which uncharges them.
+ * With -c, the process first moves itself to the given memory cgroup.
+ *
+ * Compare a kernel booted with cgroup_disable=memory, the root cgroup,
+ * whose pages are not charged to a res_counter, and a child cgroup:
+ *
+ *	# memcg-fault-bench
+ *	# mkdir /dev/cgroup/memory/bench
+ *	# memcg-fault-bench -c /dev/cgroup/memory/bench
+ *
+ * Usage: memcg-fault-bench [-s size_mb] [-n runs] [-c cgroup_dir]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void join_cgroup(const char *dir)
+{
+	char path[4096];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f || fprintf(f, "%d\n", getpid()) < 0 || fclose(f)) {
+		perror(path);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double fault = 0, unmap = 0, fault_min = 0, unmap_min = 0;
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = 64 << 20;
+	int runs = 10;
+	size_t off;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "s:n:c:")) != -1) {
+		switch (opt) {
+		case 's':
+			size = (size_t)atoi(optarg) << 20;
+			break;
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		case 'c':
+			join_cgroup(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s size_mb] [-n runs] "
+				"[-c cgroup_dir]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!size || runs <= 0) {
+		fprintf(stderr, "size and runs must be positive\n");
+		return 1;
+	}
+
+	for (i = 0; i < runs; i++) {
+		double t0, t1, t2;
+		char *p;
+
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+
+		t0 = now();
+		for (off = 0; off < size; off += page_size)
+			p[off] = 1;
+		t1 = now();
+		munmap(p, size);
+		t2 = now();
+
+		fault += t1 - t0;
+		unmap += t2 - t1;
+		if (!i || t1 - t0 < fault_min)
+			fault_min = t1 - t0;
+		if (!i || t2 - t1 < unmap_min)
+			unmap_min = t2 - t1;
+	}
+
+	printf("%d runs of %zu pages\n", runs, size / page_size);
+	printf("fault:  avg %.0f ns/page, min %.0f ns/page\n",
+	       fault * 1e9 / runs / (size / page_size),
+	       fault_min * 1e9 / (size / page_size));
+	printf("munmap: avg %.0f ns/page, min %.0f ns/page\n",
+	       unmap * 1e9 / runs / (size / page_size),
+	       unmap_min * 1e9 / (size / page_size));
+	return 0;
+}
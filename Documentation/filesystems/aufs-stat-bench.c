@@ -0,0 +1,198 @@
+/*
+ * stat() benchmark of a three branch aufs union.
+ *
+ * Builds a union of three branches below workdir, where the files of the
+ * test directory exist in the lowest branch only, and stats them and as
+ * many names which exist in no branch.  Each target is measured
+ *
+ *	cold	after dropping all caches,
+ *	warm	right after, when the dentries are all cached,
+ *	relook	after dropping the dentries and inodes while the test
+ *		directory is kept open, so that every name is looked up
+ *		again while the directory, its lower directories and the
+ *		aufs lookup cache of CONFIG_AUFS_LCACHE stay in memory.
+ *
+ * The targets are the lowest branch itself, and the union mounted with
+ * udba=reval, which never uses the lookup cache, and with udba=none.
+ *
+ *	# aufs-stat-bench -n 5000 /data/local/tmp/bench
+ *
+ * Must be run as root to mount and to drop the caches.
+ *
+ * Usage: aufs-stat-bench [-n names] [-r runs] workdir
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static const char *branch[] = { "b0", "b1", "b2" };
+
+static double now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+static void drop_caches(const char *what)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, what, 1) != 1) {
+		perror("drop_caches");
+		exit(1);
+	}
+	close(fd);
+}
+
+static void xmkdir(const char *path)
+{
+	if (mkdir(path, 0755) && errno != EEXIST) {
+		perror(path);
+		exit(1);
+	}
+}
+
+static void setup(const char *work, int names)
+{
+	char path[4096];
+	int i, fd;
+
+	xmkdir(work);
+	snprintf(path, sizeof(path), "%s/mnt", work);
+	xmkdir(path);
+	for (i = 0; i < 3; i++) {
+		snprintf(path, sizeof(path), "%s/%s", work, branch[i]);
+		xmkdir(path);
+		snprintf(path, sizeof(path), "%s/%s/d", work, branch[i]);
+		xmkdir(path);
+	}
+	for (i = 0; i < names; i++) {
+		snprintf(path, sizeof(path), "%s/b2/d/f%06d", work, i);
+		fd = open(path, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) {
+			perror(path);
+			exit(1);
+		}
+		close(fd);
+	}
+}
+
+/* returns the stats per second of the existing and the missing names */
+static void pass(int dfd, int names, double *pos, double *neg)
+{
+	char name[16];
+	struct stat st;
+	double t0;
+	int i;
+
+	t0 = now();
+	for (i = 0; i < names; i++) {
+		snprintf(name, sizeof(name), "f%06d", i);
+		if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW)) {
+			perror(name);
+			exit(1);
+		}
+	}
+	*pos = names / (now() - t0);
+
+	t0 = now();
+	for (i = 0; i < names; i++) {
+		snprintf(name, sizeof(name), "m%06d", i);
+		if (!fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW)
+		    || errno != ENOENT) {
+			perror(name);
+			exit(1);
+		}
+	}
+	*neg = names / (now() - t0);
+}
+
+static void run(const char *label, const char *dir, int names)
+{
+	static const char *phase[] = { "cold", "warm", "relook" };
+	double pos, neg;
+	int dfd, i;
+
+	drop_caches("3");
+	dfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dfd < 0) {
+		perror(dir);
+		exit(1);
+	}
+	for (i = 0; i < 3; i++) {
+		if (i == 2)
+			drop_caches("2");
+		pass(dfd, names, &pos, &neg);
+		printf("%-12s %-7s %12.0f %12.0f\n", label, phase[i], pos, neg);
+	}
+	close(dfd);
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *udba[] = { "reval", "none" };
+	char mnt[4096], dir[4096], opt[4096 * 3 + 64], label[32];
+	const char *work;
+	int names = 2000, runs = 1, run_i, i, c;
+
+	while ((c = getopt(argc, argv, "n:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			names = atoi(optarg);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || names < 1 || runs < 1)
+		goto usage;
+	work = argv[optind];
+
+	setup(work, names);
+	snprintf(mnt, sizeof(mnt), "%s/mnt", work);
+	snprintf(dir, sizeof(dir), "%s/mnt/d", work);
+
+	printf("%-12s %-7s %12s %12s\n", "target", "caches", "found/s",
+	       "missing/s");
+	for (run_i = 0; run_i < runs; run_i++) {
+		snprintf(label, sizeof(label), "b2");
+		snprintf(opt, sizeof(opt), "%s/b2/d", work);
+		run(label, opt, names);
+
+		for (i = 0; i < 2; i++) {
+			snprintf(opt, sizeof(opt),
+				 "br:%s/b0=rw:%s/b1=ro:%s/b2=ro,udba=%s",
+				 work, work, work, udba[i]);
+			if (mount("none", mnt, "aufs", 0, opt)) {
+				perror("mount aufs");
+				return 1;
+			}
+			snprintf(label, sizeof(label), "udba=%s", udba[i]);
+			run(label, dir, names);
+			if (umount(mnt)) {
+				perror("umount");
+				return 1;
+			}
+		}
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-n names] [-r runs] workdir\n", argv[0]);
+	return 1;
+}
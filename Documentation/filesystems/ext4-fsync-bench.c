@@ -0,0 +1,254 @@
+/*
+ * Small transaction fsync benchmark, SQLite style.
+ *
+ * Each transaction appends a frame of one page to a write-ahead log and
+ * fsyncs it, as SQLite does in WAL mode.  Every few transactions the log
+ * is checkpointed: the pages are written into the database file at random
+ * places, the database is fsynced and the log is rewritten from its start.
+ * This is the typical write pattern of the databases of an Android phone,
+ * and on ext4 every fsync costs a journal commit: the descriptor, the
+ * bitmap, group descriptor and inode table blocks the transaction touched
+ * and the commit record, for a few kilobytes of data.
+ *
+ * The fsync latencies are reported as percentiles, with the bytes written
+ * to the device (from /sys/dev/block/<dev>/stat) and the number of jbd2
+ * transactions and fast commits (from /proc/fs/jbd2/<dev>/info), so that
+ * a mount with -o fast_commit can be compared with one without:
+ *
+ *	# mount -t ext4 -o nofast_commit /dev/block/mmcblk0p3 /data
+ *	# ext4-fsync-bench /data
+ *	# umount /data
+ *	# mount -t ext4 -o fast_commit /dev/block/mmcblk0p3 /data
+ *	# ext4-fsync-bench /data
+ *
+ * The fast commit area is only reserved at mount time, not on remount.
+ *
+ * Usage: ext4-fsync-bench [-n transactions] [-p page_size]
+ *			   [-c checkpoint_every] [-d db_mb] directory
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/sysmacros.h>
+
+static double now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Sectors written to dev */
+static unsigned long long dev_sectors(dev_t dev)
+{
+	unsigned long long v[7];
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/stat",
+		 major(dev), minor(dev));
+	f = fopen(path, "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1],
+		   &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+		v[6] = 0;
+	fclose(f);
+	return v[6];
+}
+
+/* Find /proc/fs/jbd2/<devname>-<journal inode>/info for dev */
+static int jbd2_info_path(dev_t dev, char *path, size_t len)
+{
+	char name[256] = "", line[256];
+	struct dirent *de;
+	size_t n;
+	DIR *d;
+	FILE *f;
+
+	snprintf(line, sizeof(line), "/sys/dev/block/%u:%u/uevent",
+		 major(dev), minor(dev));
+	f = fopen(line, "r");
+	if (f == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "DEVNAME=%255s", name) == 1)
+			break;
+	fclose(f);
+	if (!name[0])
+		return -1;
+
+	d = opendir("/proc/fs/jbd2");
+	if (d == NULL)
+		return -1;
+	n = strlen(name);
+	while ((de = readdir(d)) != NULL) {
+		if (!strncmp(de->d_name, name, n) && de->d_name[n] == '-') {
+			snprintf(path, len, "/proc/fs/jbd2/%s/info",
+				 de->d_name);
+			closedir(d);
+			return 0;
+		}
+	}
+	closedir(d);
+	return -1;
+}
+
+static void jbd2_stats(const char *path, unsigned long *commits,
+		       unsigned long *fast)
+{
+	char line[256];
+	FILE *f;
+
+	*commits = *fast = 0;
+	if (!path[0])
+		return;
+	f = fopen(path, "r");
+	if (f == NULL)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		sscanf(line, "%lu transaction", commits);
+		sscanf(line, "%lu fast commits", fast);
+	}
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	int ntx = 2000, page = 4096, ckpt = 100, db_mb = 8;
+	unsigned long commits0, fast0, commits, fast;
+	unsigned long long sectors0, sectors;
+	char wal_name[4096], db_name[4096], info[512] = "";
+	double *lat, t0, t, wall;
+	off_t wal_off = 0, db_pages;
+	int wal, db, c, i, j;
+	struct stat st;
+	char *buf;
+
+	while ((c = getopt(argc, argv, "n:p:c:d:")) != -1) {
+		switch (c) {
+		case 'n':
+			ntx = atoi(optarg);
+			break;
+		case 'p':
+			page = atoi(optarg);
+			break;
+		case 'c':
+			ckpt = atoi(optarg);
+			break;
+		case 'd':
+			db_mb = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || ntx < 1 || page < 512 || ckpt < 1 ||
+	    db_mb < 1)
+		goto usage;
+
+	snprintf(db_name, sizeof(db_name), "%s/fsync-bench.db", argv[optind]);
+	snprintf(wal_name, sizeof(wal_name), "%s/fsync-bench.db-wal",
+		 argv[optind]);
+	buf = malloc(page);
+	lat = calloc(ntx, sizeof(*lat));
+	if (buf == NULL || lat == NULL) {
+		perror("malloc");
+		return 1;
+	}
+	memset(buf, 0x5a, page);
+
+	/* Create both files beforehand, new inodes always commit fully */
+	db = open(db_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	wal = open(wal_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (db < 0 || wal < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	db_pages = (off_t)db_mb * 1048576 / page;
+	for (i = 0; i < db_pages; i++)
+		if (write(db, buf, page) != page) {
+			perror(db_name);
+			return 1;
+		}
+	if (fsync(db) || fstat(db, &st)) {
+		perror(db_name);
+		return 1;
+	}
+	sync();
+	jbd2_info_path(st.st_dev, info, sizeof(info));
+
+	srand(1);
+	sectors0 = dev_sectors(st.st_dev);
+	jbd2_stats(info, &commits0, &fast0);
+	t0 = now();
+	for (i = 0; i < ntx; i++) {
+		buf[0] = i;
+		if (pwrite(wal, buf, page, wal_off) != page) {
+			perror(wal_name);
+			return 1;
+		}
+		wal_off += page;
+		t = now();
+		if (fdatasync(wal)) {
+			perror(wal_name);
+			return 1;
+		}
+		lat[i] = now() - t;
+
+		if ((i + 1) % ckpt)
+			continue;
+		for (j = 0; j < ckpt; j++)
+			if (pwrite(db, buf, page,
+				   (rand() % db_pages) * page) != page) {
+				perror(db_name);
+				return 1;
+			}
+		if (fdatasync(db)) {
+			perror(db_name);
+			return 1;
+		}
+		wal_off = 0;
+	}
+	wall = now() - t0;
+	sectors = dev_sectors(st.st_dev);
+	jbd2_stats(info, &commits, &fast);
+
+	qsort(lat, ntx, sizeof(*lat), cmp_double);
+	printf("%d transactions in %.2f s, %.0f/s\n", ntx, wall, ntx / wall);
+	printf("fsync latency ms: p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+	       lat[ntx / 2] * 1e3, lat[ntx * 9 / 10] * 1e3,
+	       lat[ntx * 99 / 100] * 1e3, lat[ntx - 1] * 1e3);
+	printf("device writes: %.1f MB, %.1f KB per transaction\n",
+	       (sectors - sectors0) / 2048.0,
+	       (sectors - sectors0) / 2.0 / ntx);
+	if (info[0])
+		printf("jbd2: %lu commits, %lu fast commits\n",
+		       commits - commits0, fast - fast0);
+
+	close(wal);
+	close(db);
+	unlink(wal_name);
+	unlink(db_name);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-n transactions] [-p page_size] "
+		"[-c checkpoint_every] [-d db_mb] directory\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,356 @@
+/*
+ * Random write benchmark of a filesystem against a simulated flash
+ * translation layer.
+ *
+ * Cheap SD cards map their flash in allocation units of one or a few erase
+ * blocks, and can keep only a couple of units open for writing.  Writing
+ * into another unit closes the least recently used one: a unit written
+ * sequentially from its start costs only an erase, any other one has to
+ * be merged, which copies all its pages.  Random writes spread over many
+ * units are therefore much slower than their size suggests.
+ *
+ * The benchmark writes into files below the mountpoint with two patterns,
+ * appends interleaved between many files (which is where the allocator
+ * decides the layout) and random overwrites of the written data.  The
+ * writes the filesystem sends to the device are recorded with the
+ * block_bio_queue trace event, and fed into a model of such an FTL, which
+ * gives the time the card would have needed.  Comparing an ext4 mount with
+ * and without -o erase_block on a loop device shows the effect of erase
+ * block aligned allocation without wearing out a real card:
+ *
+ *	# dd if=/dev/zero of=/data/ext4.img bs=1M count=512
+ *	# mke2fs -t ext4 -b 4096 /data/ext4.img
+ *	# losetup /dev/block/loop0 /data/ext4.img
+ *	# mount -t ext4 /dev/block/loop0 /mnt/t
+ *	# ext4-ftl-bench /mnt/t /dev/block/loop0
+ *	# umount /mnt/t
+ *	# mke2fs -t ext4 -b 4096 /dev/block/loop0
+ *	# mount -t ext4 -o erase_block=1024 /dev/block/loop0 /mnt/t
+ *	# ext4-ftl-bench /mnt/t /dev/block/loop0
+ *
+ * Needs the block trace events (CONFIG_BLK_DEV_IO_TRACE) and debugfs
+ * mounted on /sys/kernel/debug, and must be run as root.
+ *
+ * Usage: ext4-ftl-bench [-e unit_kb] [-o open_units] [-f files]
+ *			 [-s total_mb] [-b write_kb] [-y fsync_every]
+ *			 [-P prog_us] [-R read_us] [-E erase_us]
+ *			 mountpoint device
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/sysmacros.h>
+
+#define TRACING		"/sys/kernel/debug/tracing"
+#define FTL_PAGE	4096
+
+/* the model */
+static unsigned long unit_pages = 1024;	/* 4 MB allocation units */
+static int nopen = 2;
+static double prog_us = 400, read_us = 50, erase_us = 2000;
+
+struct unit {
+	long long no;			/* -1 if the slot is free */
+	unsigned long next;		/* next page of a sequential unit */
+	int seq;
+	unsigned long long used;	/* for LRU */
+};
+
+struct ftl {
+	struct unit *open;
+	unsigned long long clock;
+	double us;
+	unsigned long pages, reqs, switches, partial, full;
+};
+
+static double now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+static void ftl_close(struct ftl *f, struct unit *u)
+{
+	if (u->no < 0)
+		return;
+	if (u->seq && u->next == unit_pages) {
+		f->switches++;
+		f->us += erase_us;
+	} else if (u->seq) {
+		/* copy the rest of the old unit behind the written pages */
+		f->partial++;
+		f->us += (unit_pages - u->next) * (read_us + prog_us) +
+			erase_us;
+	} else {
+		f->full++;
+		f->us += unit_pages * (read_us + prog_us) + 2 * erase_us;
+	}
+	u->no = -1;
+}
+
+static void ftl_write_page(struct ftl *f, unsigned long long page)
+{
+	long long no = page / unit_pages;
+	unsigned long off = page % unit_pages;
+	struct unit *u, *lru;
+	int i;
+
+	u = NULL;
+	lru = f->open;
+	for (i = 0; i < nopen; i++) {
+		if (f->open[i].no == no) {
+			u = f->open + i;
+			break;
+		}
+		if (f->open[i].no < 0 ||
+		    (lru->no >= 0 && f->open[i].used < lru->used))
+			lru = f->open + i;
+	}
+	if (!u) {
+		u = lru;
+		ftl_close(f, u);
+		u->no = no;
+		u->next = 0;
+		u->seq = 1;
+	}
+	if (u->seq && off != u->next)
+		u->seq = 0;
+	u->next = off + 1;
+	u->used = ++f->clock;
+	f->us += prog_us;
+	f->pages++;
+}
+
+static void ftl_write(struct ftl *f, unsigned long long sector,
+		      unsigned long nr)
+{
+	unsigned long long first, last;
+
+	if (!nr)
+		return;
+	f->reqs++;
+	first = sector * 512 / FTL_PAGE;
+	last = ((sector + nr) * 512 - 1) / FTL_PAGE;
+	while (first <= last)
+		ftl_write_page(f, first++);
+}
+
+static void ftl_finish(struct ftl *f)
+{
+	int i;
+
+	for (i = 0; i < nopen; i++)
+		ftl_close(f, f->open + i);
+}
+
+static void tracing(const char *file, const char *val)
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), TRACING "/%s", file);
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0 || write(fd, val, strlen(val)) != (ssize_t)strlen(val)) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+}
+
+static void trace_start(void)
+{
+	tracing("buffer_size_kb", "16384");
+	tracing("trace", "");
+	tracing("events/block/block_bio_queue/enable", "1");
+}
+
+/* feed the writes to dev recorded since trace_start() into the model */
+static void trace_stop(dev_t dev, struct ftl *f)
+{
+	char line[512], rwbs[16];
+	unsigned long long sector;
+	unsigned int major, minor;
+	unsigned long nr;
+	const char *p;
+	FILE *fp;
+
+	sync();
+	tracing("events/block/block_bio_queue/enable", "0");
+	fp = fopen(TRACING "/trace", "r");
+	if (fp == NULL) {
+		perror(TRACING "/trace");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		p = strstr(line, "block_bio_queue: ");
+		if (p == NULL)
+			continue;
+		if (sscanf(p, "block_bio_queue: %u,%u %15s %llu + %lu",
+			   &major, &minor, rwbs, &sector, &nr) != 5)
+			continue;
+		if (major != major(dev) || minor != minor(dev) ||
+		    !strchr(rwbs, 'W'))
+			continue;
+		ftl_write(f, sector, nr);
+	}
+	fclose(fp);
+	ftl_finish(f);
+}
+
+static void report(const char *name, unsigned long long bytes, double wall,
+		   struct ftl *f)
+{
+	double sim = f->us / 1e6;
+
+	printf("%-10s %8.1f %8.1f %8lu %8lu %8lu %8lu %9.2f %9.2f\n", name,
+	       bytes / 1048576.0, f->pages * (double)FTL_PAGE / 1048576.0,
+	       f->reqs, f->switches, f->partial, f->full,
+	       bytes / 1048576.0 / wall, sim > 0 ? bytes / 1048576.0 / sim : 0);
+}
+
+int main(int argc, char *argv[])
+{
+	int nfiles = 64, total_mb = 64, write_kb = 16, fsync_every = 16;
+	unsigned long long bytes, total;
+	struct ftl append, overwrite;
+	unsigned int seed = 1;
+	char path[4096], *buf;
+	off_t *size;
+	struct stat st;
+	double t0;
+	int *fd, c, i, n;
+
+	while ((c = getopt(argc, argv, "e:o:f:s:b:y:P:R:E:")) != -1) {
+		switch (c) {
+		case 'e':
+			unit_pages = atol(optarg) * 1024 / FTL_PAGE;
+			break;
+		case 'o':
+			nopen = atoi(optarg);
+			break;
+		case 'f':
+			nfiles = atoi(optarg);
+			break;
+		case 's':
+			total_mb = atoi(optarg);
+			break;
+		case 'b':
+			write_kb = atoi(optarg);
+			break;
+		case 'y':
+			fsync_every = atoi(optarg);
+			break;
+		case 'P':
+			prog_us = atof(optarg);
+			break;
+		case 'R':
+			read_us = atof(optarg);
+			break;
+		case 'E':
+			erase_us = atof(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 2 || !unit_pages || nopen < 1 || nfiles < 1 ||
+	    total_mb < 1 || write_kb < 1 || fsync_every < 0)
+		goto usage;
+	if (stat(argv[optind + 1], &st) || !S_ISBLK(st.st_mode)) {
+		fprintf(stderr, "%s: not a block device\n", argv[optind + 1]);
+		return 1;
+	}
+
+	memset(&append, 0, sizeof(append));
+	memset(&overwrite, 0, sizeof(overwrite));
+	append.open = calloc(nopen, sizeof(struct unit));
+	overwrite.open = calloc(nopen, sizeof(struct unit));
+	fd = calloc(nfiles, sizeof(*fd));
+	size = calloc(nfiles, sizeof(*size));
+	buf = malloc(write_kb * 1024);
+	if (!append.open || !overwrite.open || !fd || !size || !buf) {
+		perror("malloc");
+		return 1;
+	}
+	for (i = 0; i < nopen; i++)
+		append.open[i].no = overwrite.open[i].no = -1;
+	memset(buf, 0x5a, write_kb * 1024);
+
+	for (i = 0; i < nfiles; i++) {
+		snprintf(path, sizeof(path), "%s/ftl-bench.%d", argv[optind], i);
+		fd[i] = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd[i] < 0) {
+			perror(path);
+			return 1;
+		}
+	}
+	sync();
+	total = (unsigned long long)total_mb << 20;
+
+	/* appends interleaved between the files */
+	trace_start();
+	t0 = now();
+	for (bytes = 0, n = 0; bytes < total; bytes += write_kb * 1024, n++) {
+		i = rand_r(&seed) % nfiles;
+		if (pwrite(fd[i], buf, write_kb * 1024, size[i]) !=
+		    write_kb * 1024) {
+			perror("pwrite");
+			return 1;
+		}
+		size[i] += write_kb * 1024;
+		if (fsync_every && n % fsync_every == fsync_every - 1)
+			fsync(fd[i]);
+	}
+	for (i = 0; i < nfiles; i++)
+		fsync(fd[i]);
+	trace_stop(st.st_rdev, &append);
+	printf("%-10s %8s %8s %8s %8s %8s %8s %9s %9s\n", "pattern", "MB",
+	       "dev MB", "bios", "switch", "partial", "full", "MB/s",
+	       "sim MB/s");
+	report("append", bytes, now() - t0, &append);
+
+	/* overwrites at random offsets of the written data */
+	trace_start();
+	t0 = now();
+	for (bytes = 0, n = 0; bytes < total; bytes += write_kb * 1024, n++) {
+		off_t blocks;
+
+		i = rand_r(&seed) % nfiles;
+		blocks = size[i] / (write_kb * 1024);
+		if (!blocks)
+			continue;
+		if (pwrite(fd[i], buf, write_kb * 1024,
+			   (rand_r(&seed) % blocks) * write_kb * 1024) !=
+		    write_kb * 1024) {
+			perror("pwrite");
+			return 1;
+		}
+		if (fsync_every && n % fsync_every == fsync_every - 1)
+			fsync(fd[i]);
+	}
+	for (i = 0; i < nfiles; i++)
+		fsync(fd[i]);
+	trace_stop(st.st_rdev, &overwrite);
+	report("overwrite", bytes, now() - t0, &overwrite);
+
+	for (i = 0; i < nfiles; i++) {
+		close(fd[i]);
+		snprintf(path, sizeof(path), "%s/ftl-bench.%d", argv[optind], i);
+		unlink(path);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-e unit_kb] [-o open_units] [-f files] "
+		"[-s total_mb] [-b write_kb]\n\t[-y fsync_every] [-P prog_us] "
+		"[-R read_us] [-E erase_us] mountpoint device\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,810 @@
+/*
+ * Benchmark of a FUSE loopback filesystem.
+ *
+ * Mounts a minimal single-threaded loopback filesystem, which forwards
+ * everything to a directory of the underlying filesystem, on mountpoint.
+ *
+ * By default it then writes a file through it, reads it back with a
+ * cold cache and reads it again with the underlying file cached, and
+ * reports the throughput of each pass.  With -p the daemon opens files
+ * in passthrough mode (FOPEN_PASSTHROUGH), so that the data does not go
+ * through it at all.  -m sets the max_write of the filesystem, values
+ * above 128 KB also need FUSE_MAX_PAGES.
+ *
+ * With -S files it instead creates that many files in a directory and
+ * has jobs processes readdir and stat all of them, passes times, like a
+ * media scanner does.  Attributes are not cached, so each stat is a
+ * request to the daemon.  It reports stats per second.  With -B the
+ * daemon uses FUSE_BATCH to read several requests per read() and send
+ * all their replies with one write().
+ *
+ * At exit the daemon reports the number of requests, reads and writes
+ * on /dev/fuse and its CPU time.
+ *
+ *	# fuse-loop-bench /data/media/tmp /mnt/fuse
+ *	# fuse-loop-bench -p /data/media/tmp /mnt/fuse
+ *	# fuse-loop-bench -S 2000 -j 4 /data/media/tmp /mnt/fuse
+ *	# fuse-loop-bench -B -S 2000 -j 4 /data/media/tmp /mnt/fuse
+ *
+ * Must be run as root to mount the filesystem and drop the caches.
+ *
+ * Usage: fuse-loop-bench [-pB] [-m max_write_kb] [-s size_mb] [-b block_kb]
+ *			  [-S files] [-j jobs] [-n passes] dir mountpoint
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+#define HASH_SIZE	4096
+
+static int passthrough, batch;
+static unsigned max_write = 128 * 1024;
+static unsigned cache_timeout = 1;
+
+/* Replies of the current batch */
+static char *out_buf;
+static size_t out_len, buf_size;
+
+static unsigned long nr_requests, nr_reads, nr_writes;
+
+/* nodeid -> path of the file in the underlying directory */
+struct node {
+	char *path;
+	struct node *hash_next;
+};
+
+static struct node *nodes;
+static uint64_t nr_nodes, max_nodes;
+static struct node *hash[HASH_SIZE];
+
+static unsigned hash_path(const char *s)
+{
+	unsigned h = 5381;
+
+	while (*s)
+		h = h * 33 + *s++;
+	return h % HASH_SIZE;
+}
+
+static uint64_t get_node(const char *path)
+{
+	unsigned h = hash_path(path);
+	struct node *n;
+
+	for (n = hash[h]; n; n = n->hash_next)
+		if (!strcmp(n->path, path))
+			return n - nodes;
+
+	if (nr_nodes == max_nodes) {
+		/* hash chains point into the array, so rebuild them */
+		uint64_t i;
+
+		max_nodes = max_nodes ? max_nodes * 2 : 1024;
+		nodes = realloc(nodes, max_nodes * sizeof(*nodes));
+		if (!nodes) {
+			perror("realloc");
+			exit(1);
+		}
+		memset(hash, 0, sizeof(hash));
+		for (i = 1; i < nr_nodes; i++) {
+			unsigned j = hash_path(nodes[i].path);
+
+			nodes[i].hash_next = hash[j];
+			hash[j] = &nodes[i];
+		}
+		h = hash_path(path);
+	}
+	if (!nr_nodes)
+		nr_nodes = 1;	/* nodeid 0 is invalid */
+
+	n = &nodes[nr_nodes];
+	n->path = strdup(path);
+	n->hash_next = hash[h];
+	hash[h] = n;
+	return nr_nodes++;
+}
+
+static const char *child_path(uint64_t parent, const char *name)
+{
+	static char path[PATH_MAX];
+	size_t dirlen = strlen(nodes[parent].path), len = strlen(name);
+
+	if (dirlen + 1 + len >= sizeof(path))
+		return NULL;
+	memcpy(path, nodes[parent].path, dirlen);
+	path[dirlen] = '/';
+	memcpy(path + dirlen + 1, name, len + 1);
+	return path;
+}
+
+/*
+ * Write the queued replies.  A failed reply, e.g. to a request which was
+ * interrupted meanwhile, stops the write; skip it and write the rest.
+ */
+static void flush_replies(int fd)
+{
+	size_t off = 0;
+	ssize_t n;
+
+	while (off < out_len) {
+		n = write(fd, out_buf + off, out_len - off);
+		nr_writes++;
+		if (n < 0) {
+			struct fuse_out_header out;
+
+			if (errno != ENOENT)
+				perror("write /dev/fuse");
+			memcpy(&out, out_buf + off, sizeof(out));
+			n = out.len;
+		}
+		off += n;
+	}
+	out_len = 0;
+}
+
+static void reply(int fd, struct fuse_in_header *in, int error,
+		  const void *arg, size_t len)
+{
+	struct fuse_out_header out;
+
+	if (error)
+		len = 0;
+	out.len = sizeof(out) + len;
+	out.error = error;
+	out.unique = in->unique;
+	if (out_len + out.len > buf_size)
+		flush_replies(fd);
+	memcpy(out_buf + out_len, &out, sizeof(out));
+	memcpy(out_buf + out_len + sizeof(out), arg, len);
+	out_len += out.len;
+	if (!batch)
+		flush_replies(fd);
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = st->st_ino;
+	attr->size = st->st_size;
+	attr->blocks = st->st_blocks;
+	attr->atime = st->st_atime;
+	attr->mtime = st->st_mtime;
+	attr->ctime = st->st_ctime;
+	attr->mode = st->st_mode;
+	attr->nlink = st->st_nlink;
+	attr->uid = st->st_uid;
+	attr->gid = st->st_gid;
+	attr->rdev = st->st_rdev;
+	attr->blksize = st->st_blksize;
+}
+
+static int fill_entry(struct fuse_entry_out *entry, const char *path)
+{
+	struct stat st;
+
+	if (!path)
+		return -ENAMETOOLONG;
+	if (lstat(path, &st))
+		return -errno;
+	memset(entry, 0, sizeof(*entry));
+	entry->nodeid = get_node(path);
+	entry->entry_valid = cache_timeout;
+	entry->attr_valid = cache_timeout;
+	fill_attr(&entry->attr, &st);
+	return 0;
+}
+
+static void do_init(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_init_in *init = arg;
+	struct fuse_init_out out;
+	unsigned flags = FUSE_ASYNC_READ | FUSE_BIG_WRITES;
+
+	if (passthrough)
+		flags |= FUSE_PASSTHROUGH;
+	if (batch)
+		flags |= FUSE_BATCH;
+	if (max_write > 32 * (unsigned)getpagesize())
+		flags |= FUSE_MAX_PAGES;
+
+	memset(&out, 0, sizeof(out));
+	out.major = FUSE_KERNEL_VERSION;
+	out.minor = FUSE_KERNEL_MINOR_VERSION;
+	out.max_readahead = init->max_readahead;
+	out.flags = init->flags & flags;
+	out.max_background = 12;
+	out.congestion_threshold = 9;
+	out.max_write = max_write;
+	out.max_pages = max_write / getpagesize();
+	if (passthrough && !(out.flags & FUSE_PASSTHROUGH))
+		fprintf(stderr, "kernel does not support passthrough\n");
+	if (batch && !(out.flags & FUSE_BATCH))
+		fprintf(stderr, "kernel does not support batches\n");
+	if ((flags & FUSE_MAX_PAGES) && !(out.flags & FUSE_MAX_PAGES))
+		fprintf(stderr, "kernel does not support max_pages\n");
+	reply(fd, in, 0, &out, sizeof(out));
+}
+
+static void do_getattr(int fd, struct fuse_in_header *in)
+{
+	struct fuse_attr_out out;
+	struct stat st;
+
+	if (lstat(nodes[in->nodeid].path, &st)) {
+		reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+	memset(&out, 0, sizeof(out));
+	out.attr_valid = cache_timeout;
+	fill_attr(&out.attr, &st);
+	reply(fd, in, 0, &out, sizeof(out));
+}
+
+static void do_setattr(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_setattr_in *set = arg;
+	const char *path = nodes[in->nodeid].path;
+	int err = 0;
+
+	if ((set->valid & FATTR_MODE) && chmod(path, set->mode))
+		err = -errno;
+	if (!err && (set->valid & (FATTR_UID | FATTR_GID)) &&
+	    lchown(path, (set->valid & FATTR_UID) ? set->uid : (uid_t)-1,
+		   (set->valid & FATTR_GID) ? set->gid : (gid_t)-1))
+		err = -errno;
+	if (!err && (set->valid & FATTR_SIZE) &&
+	    ((set->valid & FATTR_FH) ? ftruncate(set->fh, set->size) :
+	     truncate(path, set->size)))
+		err = -errno;
+	if (!err && (set->valid & (FATTR_ATIME | FATTR_MTIME))) {
+		struct timespec ts[2];
+
+		ts[0].tv_sec = set->atime;
+		ts[0].tv_nsec = (set->valid & FATTR_ATIME) ?
+			set->atimensec : UTIME_OMIT;
+		ts[1].tv_sec = set->mtime;
+		ts[1].tv_nsec = (set->valid & FATTR_MTIME) ?
+			set->mtimensec : UTIME_OMIT;
+		if (utimensat(AT_FDCWD, path, ts, AT_SYMLINK_NOFOLLOW))
+			err = -errno;
+	}
+	if (err)
+		reply(fd, in, err, NULL, 0);
+	else
+		do_getattr(fd, in);
+}
+
+static int open_backing(const char *path, int flags, int mode)
+{
+	flags &= ~O_NOCTTY;
+	/* the kernel may read pages of a write-only file to fill them */
+	if ((flags & O_ACCMODE) == O_WRONLY)
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+	return open(path, flags, mode);
+}
+
+static void fill_open(struct fuse_open_out *out, int backing)
+{
+	memset(out, 0, sizeof(*out));
+	out->fh = backing;
+	if (passthrough) {
+		out->open_flags |= FOPEN_PASSTHROUGH;
+		out->passthrough_fd = backing;
+	}
+}
+
+static void do_open(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_open_in *open_in = arg;
+	struct fuse_open_out out;
+	int backing;
+
+	backing = open_backing(nodes[in->nodeid].path, open_in->flags, 0);
+	if (backing < 0) {
+		reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+	fill_open(&out, backing);
+	reply(fd, in, 0, &out, sizeof(out));
+}
+
+static void do_create(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_create_in *create = arg;
+	const char *path = child_path(in->nodeid, (char *)(create + 1));
+	struct {
+		struct fuse_entry_out entry;
+		struct fuse_open_out open;
+	} out;
+	int backing, err;
+
+	if (!path) {
+		reply(fd, in, -ENAMETOOLONG, NULL, 0);
+		return;
+	}
+	backing = open_backing(path, create->flags | O_CREAT, create->mode);
+	if (backing < 0) {
+		reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+	err = fill_entry(&out.entry, path);
+	if (err) {
+		close(backing);
+		reply(fd, in, err, NULL, 0);
+		return;
+	}
+	fill_open(&out.open, backing);
+	reply(fd, in, 0, &out, sizeof(out));
+}
+
+static void do_read(int fd, struct fuse_in_header *in, void *arg, char *buf)
+{
+	struct fuse_read_in *read_in = arg;
+	ssize_t n;
+
+	n = pread(read_in->fh, buf, read_in->size, read_in->offset);
+	reply(fd, in, n < 0 ? -errno : 0, buf, n < 0 ? 0 : n);
+}
+
+static void do_write(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_write_in *write_in = arg;
+	struct fuse_write_out out;
+	ssize_t n;
+
+	n = pwrite(write_in->fh, write_in + 1, write_in->size,
+		   write_in->offset);
+	memset(&out, 0, sizeof(out));
+	out.size = n < 0 ? 0 : n;
+	reply(fd, in, n < 0 ? -errno : 0, &out, sizeof(out));
+}
+
+static void do_readdir(int fd, struct fuse_in_header *in, void *arg,
+		       char *buf)
+{
+	struct fuse_read_in *read_in = arg;
+	DIR *dp = (DIR *)(uintptr_t)read_in->fh;
+	struct dirent *de;
+	size_t len = 0;
+
+	if (read_in->offset)
+		seekdir(dp, read_in->offset);
+	else
+		rewinddir(dp);
+
+	while ((de = readdir(dp)) != NULL) {
+		struct fuse_dirent *d = (struct fuse_dirent *)(buf + len);
+		size_t namelen = strlen(de->d_name);
+		size_t size = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+
+		if (len + size > read_in->size)
+			break;
+		d->ino = de->d_ino;
+		d->off = telldir(dp);
+		d->namelen = namelen;
+		d->type = de->d_type;
+		memcpy(d->name, de->d_name, namelen);
+		memset(d->name + namelen, 0, size - FUSE_NAME_OFFSET - namelen);
+		len += size;
+	}
+	reply(fd, in, 0, buf, len);
+}
+
+static void do_statfs(int fd, struct fuse_in_header *in)
+{
+	struct fuse_statfs_out out;
+	struct statvfs st;
+
+	if (statvfs(nodes[1].path, &st)) {
+		reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+	memset(&out, 0, sizeof(out));
+	out.st.blocks = st.f_blocks;
+	out.st.bfree = st.f_bfree;
+	out.st.bavail = st.f_bavail;
+	out.st.files = st.f_files;
+	out.st.ffree = st.f_ffree;
+	out.st.bsize = st.f_bsize;
+	out.st.namelen = st.f_namemax;
+	out.st.frsize = st.f_frsize;
+	reply(fd, in, 0, &out, sizeof(out));
+}
+
+/* Handle one request; FORGET and INTERRUPT get no reply */
+static void handle(int fd, struct fuse_in_header *in, char *buf)
+{
+	void *arg = in + 1;
+	struct fuse_entry_out entry;
+	int err = 0;
+
+	switch (in->opcode) {
+	case FUSE_INIT:
+		do_init(fd, in, arg);
+		break;
+	case FUSE_LOOKUP:
+		err = fill_entry(&entry, child_path(in->nodeid, arg));
+		reply(fd, in, err, &entry, sizeof(entry));
+		break;
+	case FUSE_FORGET:
+	case FUSE_INTERRUPT:
+		break;
+	case FUSE_GETATTR:
+		do_getattr(fd, in);
+		break;
+	case FUSE_SETATTR:
+		do_setattr(fd, in, arg);
+		break;
+	case FUSE_OPEN:
+		do_open(fd, in, arg);
+		break;
+	case FUSE_CREATE:
+		do_create(fd, in, arg);
+		break;
+	case FUSE_READ:
+		do_read(fd, in, arg, buf);
+		break;
+	case FUSE_WRITE:
+		do_write(fd, in, arg);
+		break;
+	case FUSE_FLUSH:
+		reply(fd, in, 0, NULL, 0);
+		break;
+	case FUSE_FSYNC:
+		err = fsync(((struct fuse_fsync_in *)arg)->fh) ? -errno : 0;
+		reply(fd, in, err, NULL, 0);
+		break;
+	case FUSE_RELEASE:
+		close(((struct fuse_release_in *)arg)->fh);
+		reply(fd, in, 0, NULL, 0);
+		break;
+	case FUSE_UNLINK: {
+		const char *path = child_path(in->nodeid, arg);
+
+		err = !path ? -ENAMETOOLONG : unlink(path) ? -errno : 0;
+		reply(fd, in, err, NULL, 0);
+		break;
+	}
+	case FUSE_OPENDIR: {
+		struct fuse_open_out out;
+		DIR *dp = opendir(nodes[in->nodeid].path);
+
+		memset(&out, 0, sizeof(out));
+		out.fh = (uintptr_t)dp;
+		reply(fd, in, dp ? 0 : -errno, &out, sizeof(out));
+		break;
+	}
+	case FUSE_READDIR:
+		do_readdir(fd, in, arg, buf);
+		break;
+	case FUSE_RELEASEDIR:
+		closedir((DIR *)(uintptr_t)((struct fuse_release_in *)arg)->fh);
+		reply(fd, in, 0, NULL, 0);
+		break;
+	case FUSE_STATFS:
+		do_statfs(fd, in);
+		break;
+	default:
+		reply(fd, in, -ENOSYS, NULL, 0);
+		break;
+	}
+}
+
+static double tv(struct timeval *t)
+{
+	return t->tv_sec + t->tv_usec / 1e6;
+}
+
+static void daemon_loop(int fd, const char *dir)
+{
+	char *req, *buf, *aligned;
+	struct rusage ru;
+	ssize_t n, off, len;
+
+	/* a read request may be larger than max_write without max_pages */
+	buf_size = 32 * getpagesize();
+	if (buf_size < max_write)
+		buf_size = max_write;
+	buf_size += 4096;
+	req = malloc(buf_size);
+	buf = malloc(buf_size);
+	aligned = malloc(buf_size);
+	out_buf = malloc(buf_size);
+	if (!req || !buf || !aligned || !out_buf) {
+		perror("malloc");
+		exit(1);
+	}
+
+	get_node(dir);		/* FUSE_ROOT_ID */
+
+	for (;;) {
+		n = read(fd, req, buf_size);
+		if (n < 0) {
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			if (errno != ENODEV)
+				perror("read /dev/fuse");
+			break;
+		}
+		nr_reads++;
+
+		for (off = 0; off < n; off += len) {
+			struct fuse_in_header *in = (void *)(req + off);
+
+			/* Requests of a batch follow each other unaligned */
+			if (off & 7) {
+				memcpy(aligned, in, sizeof(*in));
+				in = (struct fuse_in_header *)aligned;
+				memcpy(aligned, req + off, in->len);
+			}
+			len = in->len;
+			handle(fd, in, buf);
+			nr_requests++;
+		}
+		flush_replies(fd);
+	}
+
+	getrusage(RUSAGE_SELF, &ru);
+	printf("daemon: %lu requests, %lu reads, %lu writes, "
+	       "user %.2f s, sys %.2f s\n", nr_requests, nr_reads, nr_writes,
+	       tv(&ru.ru_utime), tv(&ru.ru_stime));
+}
+
+static double now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return tv(&t);
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3", 1) != 1) {
+		perror("drop_caches");
+		exit(1);
+	}
+	close(fd);
+}
+
+static double transfer(const char *file, int write_pass, size_t size,
+		       size_t block)
+{
+	char *buf = malloc(block);
+	size_t done;
+	double t0;
+	int fd;
+
+	memset(buf, 0x5a, block);
+	fd = write_pass ? open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644) :
+		open(file, O_RDONLY);
+	if (fd < 0) {
+		perror(file);
+		exit(1);
+	}
+	t0 = now();
+	for (done = 0; done < size; done += block) {
+		ssize_t n = write_pass ? write(fd, buf, block) :
+			read(fd, buf, block);
+		if (n != (ssize_t)block) {
+			perror(file);
+			exit(1);
+		}
+	}
+	if (write_pass && fsync(fd)) {
+		perror("fsync");
+		exit(1);
+	}
+	close(fd);
+	free(buf);
+	return size / 1048576.0 / (now() - t0);
+}
+
+/* Create or remove the files of the scan test in the underlying dir */
+static void scan_files(const char *dir, int files, int create)
+{
+	char name[32];
+	int i, dfd, fd;
+
+	if (create && mkdir(dir, 0755) && errno != EEXIST) {
+		perror(dir);
+		exit(1);
+	}
+	dfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dfd < 0) {
+		perror(dir);
+		exit(1);
+	}
+	for (i = 0; i < files; i++) {
+		snprintf(name, sizeof(name), "file%06d", i);
+		if (!create) {
+			unlinkat(dfd, name, 0);
+			continue;
+		}
+		fd = openat(dfd, name, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) {
+			perror(name);
+			exit(1);
+		}
+		close(fd);
+	}
+	close(dfd);
+	if (!create)
+		rmdir(dir);
+}
+
+static void scan(const char *dir, int passes)
+{
+	struct dirent *de;
+	struct stat st;
+	DIR *dp;
+	int i;
+
+	for (i = 0; i < passes; i++) {
+		dp = opendir(dir);
+		if (!dp) {
+			perror(dir);
+			exit(1);
+		}
+		while ((de = readdir(dp)) != NULL) {
+			if (de->d_name[0] == '.')
+				continue;
+			if (fstatat(dirfd(dp), de->d_name, &st,
+				    AT_SYMLINK_NOFOLLOW)) {
+				perror(de->d_name);
+				exit(1);
+			}
+		}
+		closedir(dp);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size = 256 << 20, block = 128 << 10;
+	int files = 0, jobs = 1, passes = 10;
+	char opts[256], file[PATH_MAX], scan_dir[PATH_MAX];
+	pid_t pid;
+	int fd, c, i;
+
+	while ((c = getopt(argc, argv, "pBm:s:b:S:j:n:")) != -1) {
+		switch (c) {
+		case 'p':
+			passthrough = 1;
+			break;
+		case 'B':
+			batch = 1;
+			break;
+		case 'm':
+			max_write = atoi(optarg) << 10;
+			break;
+		case 's':
+			size = (size_t)atoi(optarg) << 20;
+			break;
+		case 'b':
+			block = (size_t)atoi(optarg) << 10;
+			break;
+		case 'S':
+			files = atoi(optarg);
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'n':
+			passes = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind != 2 || !size || !block || max_write < 4096 ||
+	    files < 0 || jobs < 1 || passes < 1)
+		goto usage;
+	size -= size % block;
+
+	snprintf(scan_dir, sizeof(scan_dir), "%s/fuse-loop-bench.scan",
+		 argv[optind]);
+	if (files) {
+		scan_files(scan_dir, files, 1);
+		cache_timeout = 0;
+	}
+
+	fd = open("/dev/fuse", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/fuse");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0,allow_other", fd);
+	if (mount("fuse-loop", argv[optind + 1], "fuse", MS_NOSUID | MS_NODEV,
+		  opts)) {
+		perror("mount");
+		return 1;
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		daemon_loop(fd, argv[optind]);
+		exit(0);
+	}
+	close(fd);
+
+	if (files) {
+		double t0, wall;
+
+		snprintf(scan_dir, sizeof(scan_dir),
+			 "%s/fuse-loop-bench.scan", argv[optind + 1]);
+		t0 = now();
+		for (i = 0; i < jobs; i++) {
+			if (fork() == 0) {
+				scan(scan_dir, passes);
+				exit(0);
+			}
+		}
+		for (i = 0; i < jobs; i++)
+			wait(NULL);
+		wall = now() - t0;
+
+		printf("%s: %d files, %d jobs, %d passes\n",
+		       batch ? "batch" : "loopback", files, jobs, passes);
+		printf("%.0f stats/s\n", (double)files * jobs * passes / wall);
+	} else {
+		double wr, cold, warm;
+
+		snprintf(file, sizeof(file), "%s/fuse-loop-bench.dat",
+			 argv[optind + 1]);
+		wr = transfer(file, 1, size, block);
+		drop_caches();
+		cold = transfer(file, 0, size, block);
+		warm = transfer(file, 0, size, block);
+		unlink(file);
+
+		printf("%s: %zu MB in %zu KB blocks, max_write %u KB\n",
+		       passthrough ? "passthrough" : "loopback", size >> 20,
+		       block >> 10, max_write >> 10);
+		printf("write %.1f MB/s, cold read %.1f MB/s, "
+		       "warm read %.1f MB/s\n", wr, cold, warm);
+	}
+	fflush(stdout);
+
+	if (umount(argv[optind + 1])) {
+		perror("umount");
+		kill(pid, SIGTERM);
+	}
+	waitpid(pid, NULL, 0);
+
+	if (files) {
+		snprintf(scan_dir, sizeof(scan_dir), "%s/fuse-loop-bench.scan",
+			 argv[optind]);
+		scan_files(scan_dir, files, 0);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-pB] [-m max_write_kb] [-s size_mb] "
+		"[-b block_kb]\n\t[-S files] [-j jobs] [-n passes] "
+		"dir mountpoint\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,208 @@
+/*
+ * Cold read benchmark for squashfs images.
+ *
+ * For each mount point given, drops the page cache, reads every regular
+ * file below it once and reports the throughput and the CPU time spent.
+ * Squashfs decompresses in the context of the reading task, so the
+ * system time is mostly decompression.  The compressor is read from the
+ * superblock of the mounted device, so images built from the same tree
+ * with different mksquashfs -comp options can be compared in one run.
+ * The memory held by the squashfs caches of the filesystem, and how many
+ * datablocks were decompressed directly into the page cache rather than
+ * through the data cache, are taken from /proc/fs/squashfs/<dev>/cache.
+ *
+ *	# mount -o loop,ro system-zlib.sqsh /mnt/zlib
+ *	# mount -o loop,ro system-lzo.sqsh /mnt/lzo
+ *	# mount -o loop,ro system-xz.sqsh /mnt/xz
+ *	# squashfs-bench /mnt/zlib /mnt/lzo /mnt/xz
+ *
+ * Must be run as root to drop the caches.
+ *
+ * Usage: squashfs-bench [-n runs] mountpoint...
+ */
+
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define SQUASHFS_MAGIC	0x73717368
+
+static const char *comp_name[] = { "?", "zlib", "lzma", "lzo", "xz" };
+
+static char buf[65536];
+static unsigned long long bytes;
+static unsigned long files;
+
+static double tv(struct timeval *t)
+{
+	return t->tv_sec + t->tv_usec / 1e6;
+}
+
+static double now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return tv(&t);
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3", 1) != 1) {
+		perror("drop_caches");
+		exit(1);
+	}
+	close(fd);
+}
+
+/*
+ * Look up the device mounted on dir, read its compression id and return
+ * the device name as used under /proc/fs/squashfs in id.
+ */
+static const char *compressor(const char *dir, char *id, size_t len)
+{
+	char dev[4096], mnt[4096], type[64];
+	unsigned char sb[24];
+	const char *name = "?";
+	FILE *f;
+	int fd;
+
+	f = fopen("/proc/mounts", "r");
+	if (f == NULL)
+		return name;
+	while (fscanf(f, "%4095s %4095s %63s %*[^\n]", dev, mnt, type) == 3) {
+		if (strcmp(mnt, dir) || strcmp(type, "squashfs"))
+			continue;
+		snprintf(id, len, "%s", strrchr(dev, '/') ?
+			 strrchr(dev, '/') + 1 : dev);
+		fd = open(dev, O_RDONLY);
+		if (fd < 0)
+			break;
+		if (pread(fd, sb, sizeof(sb), 0) == sizeof(sb) &&
+		    (sb[0] | sb[1] << 8 | sb[2] << 16 |
+		     (unsigned)sb[3] << 24) == SQUASHFS_MAGIC &&
+		    (sb[20] | sb[21] << 8) < 5)
+			name = comp_name[sb[20] | sb[21] << 8];
+		close(fd);
+		break;
+	}
+	fclose(f);
+	return name;
+}
+
+static void cache_stats(const char *id, unsigned long *cache_bytes,
+			long *direct, long *cached)
+{
+	char path[4096], line[256];
+	unsigned long b;
+	FILE *f;
+
+	*cache_bytes = 0;
+	*direct = *cached = 0;
+	snprintf(path, sizeof(path), "/proc/fs/squashfs/%s/cache", id);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%*s %*d %*d %lu", &b) == 1)
+			*cache_bytes += b;
+		sscanf(line, "direct_reads: %ld", direct);
+		sscanf(line, "cached_reads: %ld", cached);
+	}
+	fclose(f);
+}
+
+static int read_file(const char *path, const struct stat *st, int flag,
+		     struct FTW *ftw)
+{
+	ssize_t n;
+	int fd;
+
+	(void)ftw;
+	if (flag != FTW_F || !S_ISREG(st->st_mode))
+		return 0;
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return 0;
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		bytes += n;
+	if (n < 0)
+		perror(path);
+	close(fd);
+	files++;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct rusage r0, r1;
+	double t0, wall, user, sys;
+	unsigned long cache_bytes;
+	long direct0, cached0, direct, cached;
+	char id[4096];
+	int runs = 1, i, run, c;
+
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind == argc || runs < 1)
+		goto usage;
+
+	printf("%-20s %-5s %8s %10s %9s %8s %8s %8s %8s %8s\n", "mountpoint",
+	       "comp", "files", "MB", "MB/s", "user s", "sys s", "cache KB",
+	       "direct", "cached");
+
+	for (i = optind; i < argc; i++) {
+		const char *comp;
+
+		id[0] = 0;
+		comp = compressor(argv[i], id, sizeof(id));
+
+		for (run = 0; run < runs; run++) {
+			bytes = 0;
+			files = 0;
+			drop_caches();
+			cache_stats(id, &cache_bytes, &direct0, &cached0);
+			getrusage(RUSAGE_SELF, &r0);
+			t0 = now();
+			if (nftw(argv[i], read_file, 64, FTW_PHYS | FTW_MOUNT)) {
+				perror(argv[i]);
+				break;
+			}
+			wall = now() - t0;
+			getrusage(RUSAGE_SELF, &r1);
+			cache_stats(id, &cache_bytes, &direct, &cached);
+			user = tv(&r1.ru_utime) - tv(&r0.ru_utime);
+			sys = tv(&r1.ru_stime) - tv(&r0.ru_stime);
+
+			printf("%-20s %-5s %8lu %10.1f %9.1f %8.2f %8.2f "
+			       "%8lu %8ld %8ld\n", argv[i], comp, files,
+			       bytes / 1048576.0, bytes / 1048576.0 / wall,
+			       user, sys, cache_bytes / 1024,
+			       direct - direct0, cached - cached0);
+		}
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-n runs] mountpoint...\n", argv[0]);
+	return 1;
+}
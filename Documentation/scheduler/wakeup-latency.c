@@ -0,0 +1,176 @@
+/*
+ * wakeup-latency.c
+ *
+ * Measure how late a periodic foreground task wakes up while CPU hogs
+ * are running, optionally with the foreground task and the hogs in
+ * different cpu cgroups, to see the effect of cpu.shares,
+ * cpu.latency_sensitive and cpu.contended_cap.
+ *
+ * Usage: wakeup-latency [-n hogs] [-p period_us] [-d seconds]
+ *			 [-f fg_cgroup_dir] [-b bg_cgroup_dir]
+ *
+ * Licensed under the GPL v2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define NR_BUCKETS	20
+#define MAX_HOGS	64
+
+static unsigned long long hist[NR_BUCKETS];
+
+static void join_cgroup(const char *dir)
+{
+	char path[1024];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f || fprintf(f, "%d\n", getpid()) < 0 || fclose(f)) {
+		perror(path);
+		exit(1);
+	}
+}
+
+static void hog(const char *cgroup)
+{
+	volatile unsigned long n = 0;
+
+	if (cgroup)
+		join_cgroup(cgroup);
+	for (;;)
+		n++;
+}
+
+static long long ts_diff_us(struct timespec *a, struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000LL +
+		(a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+static int bucket(long long us)
+{
+	int b = 0;
+
+	while (us > 0 && b < NR_BUCKETS - 1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "wakeup-latency [-n hogs] [-p period_us] [-d seconds] "
+			"[-f fg_cgroup_dir] [-b bg_cgroup_dir]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int nr_hogs = 4, period_us = 10000, duration = 10;
+	char *fg_cgroup = NULL, *bg_cgroup = NULL;
+	pid_t hogs[MAX_HOGS];
+	struct timespec next, now, end;
+	long long lat, min = -1, max = 0, total = 0, samples = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:p:d:f:b:")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_hogs = atoi(optarg);
+			break;
+		case 'p':
+			period_us = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'f':
+			fg_cgroup = optarg;
+			break;
+		case 'b':
+			bg_cgroup = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nr_hogs < 0 || nr_hogs > MAX_HOGS || period_us <= 0 ||
+	    duration <= 0)
+		usage();
+
+	for (i = 0; i < nr_hogs; i++) {
+		hogs[i] = fork();
+		if (hogs[i] < 0) {
+			perror("fork");
+			nr_hogs = i;
+			goto out;
+		}
+		if (!hogs[i])
+			hog(bg_cgroup);
+	}
+	if (fg_cgroup)
+		join_cgroup(fg_cgroup);
+
+	/* let the hogs settle */
+	sleep(1);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	end = next;
+	end.tv_sec += duration;
+	for (;;) {
+		next.tv_nsec += period_us * 1000L;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		if (ts_diff_us(&next, &end) > 0)
+			break;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &next, NULL) == EINTR)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		lat = ts_diff_us(&now, &next);
+		if (lat < 0)
+			lat = 0;
+		if (min < 0 || lat < min)
+			min = lat;
+		if (lat > max)
+			max = lat;
+		total += lat;
+		samples++;
+		hist[bucket(lat)]++;
+	}
+
+	printf("%d hogs, period %d us: %lld samples, "
+	       "min %lld avg %lld max %lld us\n",
+	       nr_hogs, period_us, samples, min,
+	       samples ? total / samples : 0, max);
+	printf("latency (us)      count\n");
+	for (i = 0; i < NR_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (!i)
+			printf("        < 1  %10llu\n", hist[i]);
+		else
+			printf("%6llu - %-6llu %10llu\n",
+			       1ULL << (i - 1), (1ULL << i) - 1, hist[i]);
+	}
+
+out:
+	for (i = 0; i < nr_hogs; i++) {
+		kill(hogs[i], SIGKILL);
+		waitpid(hogs[i], NULL, 0);
+	}
+	return 0;
+}
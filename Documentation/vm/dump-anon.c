@@ -0,0 +1,96 @@
+/*
+ * Dump the anonymous memory of a process, page by page.
+ *
+ * Writes every page of the private writable mappings of a process, heap
+ * and stack included, to standard output, leaving out the pages which
+ * are all zeroes since zram and ramzswap store those without compressing
+ * them.  The output is a corpus of real anonymous pages for compression
+ * tests, such as the corpus parameter of the lzo1x_test module.  The
+ * process is stopped while it is read.
+ *
+ * Usage: dump-anon pid > file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static int zero_page(const unsigned char *p, long size)
+{
+	long i;
+
+	for (i = 0; i < size; i++)
+		if (p[i])
+			return 0;
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long start, end, addr, nr = 0, zero = 0;
+	long page_size = sysconf(_SC_PAGESIZE);
+	char path[64], line[512], perms[8];
+	unsigned char *buf;
+	FILE *maps;
+	pid_t pid;
+	int mem;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s pid > file\n", argv[0]);
+		return 1;
+	}
+	pid = atoi(argv[1]);
+	buf = malloc(page_size);
+
+	/* /proc/pid/mem can only be read by a tracer */
+	if (ptrace(PTRACE_ATTACH, pid, NULL, NULL) < 0) {
+		perror("ptrace");
+		return 1;
+	}
+	waitpid(pid, NULL, 0);
+
+	snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	maps = fopen(path, "r");
+	snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+	mem = open(path, O_RDONLY);
+	if (!maps || mem < 0) {
+		perror(path);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), maps)) {
+		char name[256] = "";
+
+		if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %255s",
+			   &start, &end, perms, name) < 3)
+			continue;
+		if (perms[0] != 'r' || perms[1] != 'w' || perms[3] != 'p')
+			continue;
+		if (name[0] && strcmp(name, "[heap]") && strcmp(name, "[stack]"))
+			continue;
+
+		for (addr = start; addr < end; addr += page_size) {
+			if (pread(mem, buf, page_size, addr) != page_size)
+				continue;
+			if (zero_page(buf, page_size)) {
+				zero++;
+				continue;
+			}
+			if (fwrite(buf, page_size, 1, stdout) != 1) {
+				perror("write");
+				return 1;
+			}
+			nr++;
+		}
+	}
+
+	ptrace(PTRACE_DETACH, pid, NULL, NULL);
+	fprintf(stderr, "%lu pages written, %lu zero pages left out\n",
+		nr, zero);
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Measure the effect of fault-around on program startup.
+ *
+ * Runs a command a number of times for each given value of
+ * /sys/kernel/debug/fault_around_pages and reports the average number
+ * of minor faults it took and its average run time.  The first run of
+ * each set is not counted, so that the files it maps are in the page
+ * cache.  A program linked against several large shared libraries
+ * which exits right away shows the startup cost best.
+ *
+ * Usage: fault-around [-n runs] [-p pages[,pages...]] command [args...]
+ *
+ * E.g.:
+ *	# fault-around -n 20 -p 1,4,16,64 /system/bin/app_process --help
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define FAULT_AROUND_FILE	"/sys/kernel/debug/fault_around_pages"
+
+static void set_fault_around(const char *pages)
+{
+	FILE *f = fopen(FAULT_AROUND_FILE, "w");
+
+	if (!f || fprintf(f, "%s\n", pages) < 0 || fclose(f)) {
+		perror(FAULT_AROUND_FILE);
+		exit(1);
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Run the command once, returning its minor faults and wall time */
+static void run(char **argv, long *minflt, double *time)
+{
+	struct rusage ru;
+	int status;
+	pid_t pid;
+
+	*time = now();
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (!pid) {
+		/* keep the command's output from skewing the times */
+		if (!freopen("/dev/null", "w", stdout))
+			_exit(127);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	if (wait4(pid, &status, 0, &ru) < 0) {
+		perror("wait4");
+		exit(1);
+	}
+	*time = now() - *time;
+	*minflt = ru.ru_minflt;
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+		fprintf(stderr, "cannot run %s\n", argv[0]);
+		exit(1);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "fault-around [-n runs] [-p pages[,pages...]] "
+			"command [args...]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char *list = "1,16", *pages;
+	double time, total_time;
+	long minflt, total_flt;
+	int runs = 10, c, i;
+
+	while ((c = getopt(argc, argv, "+n:p:")) != -1) {
+		switch (c) {
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		case 'p':
+			list = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc || runs <= 0)
+		usage();
+	argv += optind;
+
+	printf("%-8s %12s %12s\n", "pages", "minflt", "msecs");
+	for (pages = strtok(list, ","); pages; pages = strtok(NULL, ",")) {
+		set_fault_around(pages);
+
+		run(argv, &minflt, &time);
+		total_flt = 0;
+		total_time = 0;
+		for (i = 0; i < runs; i++) {
+			run(argv, &minflt, &time);
+			total_flt += minflt;
+			total_time += time;
+		}
+		printf("%-8s %12ld %12.2f\n", pages, total_flt / runs,
+		       total_time * 1000 / runs);
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Measure swapin readahead while switching between "applications".
+ *
+ * Each application is an anonymous mapping filled with compressible
+ * data.  The program switches from one to the next, touching part of
+ * its pages in short runs as an application being resumed would, and
+ * reports the time and the major faults each switch took, along with
+ * the swap_ra counters of /proc/vmstat.  Make the applications add up
+ * to more than the free memory so that they get swapped out while the
+ * others run.
+ *
+ * With -s, the swap device is first (re)enabled with readahead by
+ * swap offset, or by virtual address with -v (SWAP_FLAG_VMA_RA).
+ *
+ * Usage: swap-readahead [-s swapdev [-v]] [-a apps] [-m MB per app]
+ *			 [-r rounds] [-l run length] [-w percent touched]
+ *
+ * E.g., in a 256MB guest with a 128MB zram swap device:
+ *
+ *	# echo $((128 << 20)) > /sys/block/zram0/disksize
+ *	# mkswap /dev/zram0
+ *	# swap-readahead -s /dev/zram0 -a 8 -m 40
+ *	# swap-readahead -s /dev/zram0 -v -a 8 -m 40
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/swap.h>
+
+#ifndef SWAP_FLAG_VMA_RA
+#define SWAP_FLAG_VMA_RA	0x20000
+#endif
+
+#define MAX_APPS	64
+
+static size_t page_size;
+
+static void swap_enable(const char *dev, int vma_ra)
+{
+	if (swapoff(dev) && errno != EINVAL) {
+		perror("swapoff");
+		exit(1);
+	}
+	if (swapon(dev, vma_ra ? SWAP_FLAG_VMA_RA : 0)) {
+		perror("swapon");
+		exit(1);
+	}
+}
+
+static void read_vmstat(unsigned long long *ra, unsigned long long *hit,
+			unsigned long long *miss)
+{
+	char name[64];
+	unsigned long long val;
+	FILE *f;
+
+	*ra = *hit = *miss = 0;
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", name, &val) == 2) {
+		if (!strcmp(name, "swap_ra"))
+			*ra = val;
+		else if (!strcmp(name, "swap_ra_hit"))
+			*hit = val;
+		else if (!strcmp(name, "swap_ra_miss"))
+			*miss = val;
+	}
+	fclose(f);
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(char *app, size_t pages)
+{
+	size_t i, j;
+
+	/* a third of each page random, the rest a pattern */
+	for (i = 0; i < pages; i++) {
+		char *p = app + i * page_size;
+
+		for (j = 0; j < page_size / 3; j++)
+			p[j] = rand();
+		for (; j < page_size; j++)
+			p[j] = j;
+	}
+}
+
+static void touch(char *app, size_t pages, int run, int percent)
+{
+	size_t done = 0, want = pages * percent / 100;
+	size_t start, i;
+	volatile char c;
+
+	while (done < want) {
+		start = rand() % pages;
+		for (i = start; i < start + run && i < pages; i++, done++)
+			c = app[i * page_size];
+	}
+	(void)c;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "swap-readahead [-s swapdev [-v]] [-a apps] "
+		"[-m MB per app] [-r rounds] [-l run length] "
+		"[-w percent touched]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int nr_apps = 8, mb = 32, rounds = 4, run = 8, percent = 25;
+	int vma_ra = 0, c, i, r;
+	char *dev = NULL, *apps[MAX_APPS];
+	unsigned long long ra0, hit0, miss0, ra, hit, miss;
+	double t, total_time = 0, max_time = 0;
+	long flt, total_flt = 0;
+	size_t pages;
+
+	while ((c = getopt(argc, argv, "s:va:m:r:l:w:")) != -1) {
+		switch (c) {
+		case 's':
+			dev = optarg;
+			break;
+		case 'v':
+			vma_ra = 1;
+			break;
+		case 'a':
+			nr_apps = atoi(optarg);
+			break;
+		case 'm':
+			mb = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'l':
+			run = atoi(optarg);
+			break;
+		case 'w':
+			percent = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nr_apps < 2 || nr_apps > MAX_APPS || mb <= 0 || rounds <= 0 ||
+	    run <= 0 || percent <= 0 || percent > 100)
+		usage();
+
+	if (dev)
+		swap_enable(dev, vma_ra);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	pages = ((size_t)mb << 20) / page_size;
+	srand(1);
+
+	for (i = 0; i < nr_apps; i++) {
+		apps[i] = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (apps[i] == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		fill(apps[i], pages);
+	}
+
+	read_vmstat(&ra0, &hit0, &miss0);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nr_apps; i++) {
+			flt = majflt();
+			t = now();
+			touch(apps[i], pages, run, percent);
+			t = now() - t;
+			total_flt += majflt() - flt;
+			total_time += t;
+			if (t > max_time)
+				max_time = t;
+		}
+	}
+	read_vmstat(&ra, &hit, &miss);
+
+	printf("%d switches: avg %.1f ms, max %.1f ms, "
+	       "%.1f major faults per switch\n",
+	       rounds * nr_apps, total_time * 1000 / (rounds * nr_apps),
+	       max_time * 1000, (double)total_flt / (rounds * nr_apps));
+	printf("swap_ra %llu, swap_ra_hit %llu, swap_ra_miss %llu\n",
+	       ra - ra0, hit - hit0, miss - miss0);
+
+	return 0;
+}
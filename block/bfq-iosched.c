@@ -347,6 +347,24 @@ static void bfq_updated_next_req(struct bfq_data *bfqd,
 	bfq_activate_bfqq(bfqd, bfqq);
 }
 
+/*
+ * Timestamps compared against jiffies are kept as unsigned long and
+ * checked with the time_* macros, so that they survive the wraparound
+ * of jiffies; "never" is therefore half the jiffies space from now.
+ */
+static inline unsigned long bfq_infinity_from_now(unsigned long now)
+{
+	return now + ULONG_MAX / 2;
+}
+
+static inline void bfq_bfqq_end_raising(struct bfq_queue *bfqq)
+{
+	bfqq->raising_coeff = 1;
+	bfqq->raising_cur_max_time = 0;
+	bfqq->last_rais_start_finish = jiffies;
+	bfqq->entity.ioprio_changed = 1;
+}
+
 static void bfq_add_rq_rb(struct request *rq)
 {
 	struct bfq_queue *bfqq = RQ_BFQQ(rq);
@@ -374,36 +392,76 @@ static void bfq_add_rq_rb(struct request *rq)
 	bfqq->next_rq = next_rq;
 
 	if (!bfq_bfqq_busy(bfqq)) {
+		int idle_for_long_time, soft_rt;
+		unsigned long raising_max_time;
+
 		entity->budget = max_t(bfq_service_t, bfqq->max_budget,
 				       bfq_serv_to_charge(next_rq, bfqq));
 
-		if (! bfqd->low_latency)
+		if (!bfqd->low_latency)
 			goto add_bfqq_busy;
+
 		/*
-		 * If the queue is not being boosted and has been idle
-		 * for enough time, start a boosting period
+		 * A sync queue that has been idle for a long time is
+		 * likely to belong to an application that is starting
+		 * up or reacting to the user: raise its weight for
+		 * bfq_raising_max_time.  A sync queue that comes back
+		 * no earlier than its soft_rt_next_start issues I/O at
+		 * a bounded rate, as a player or a recorder does: raise
+		 * its weight for the shorter bfq_raising_rt_max_time,
+		 * which it will keep renewing as long as it behaves.
+		 * Async queues are never raised, they mostly carry
+		 * writeback for greedy writers.
 		 */
-		if(old_raising_coeff == 1 &&
- 		    bfqq->last_rais_start_finish +
- 		    bfqd->bfq_raising_min_idle_time < jiffies) {
- 			bfqq->raising_coeff = bfqd->bfq_raising_coeff;
- 			entity->ioprio_changed = 1;
- 			bfq_log_bfqq(bfqd, bfqq,
- 				     "wrais starting at %lu msec",
- 				     bfqq->last_rais_start_finish);
-  		}
+		idle_for_long_time = time_is_before_jiffies(
+			bfqq->last_rais_start_finish +
+			bfqd->bfq_raising_min_idle_time);
+		soft_rt = bfqd->bfq_raising_max_softrt_rate > 0 &&
+			time_is_before_jiffies(bfqq->soft_rt_next_start);
+
+		if (bfq_bfqq_sync(bfqq) && (idle_for_long_time || soft_rt)) {
+			raising_max_time = idle_for_long_time ?
+				bfqd->bfq_raising_max_time :
+				bfqd->bfq_raising_rt_max_time;
+
+			if (old_raising_coeff == 1) {
+				bfqq->raising_coeff = bfqd->bfq_raising_coeff;
+				entity->ioprio_changed = 1;
+			}
+			/* Only ever extend the current raising period. */
+			if (old_raising_coeff == 1 ||
+			    time_after(jiffies + raising_max_time,
+				       bfqq->last_rais_start_finish +
+				       bfqq->raising_cur_max_time)) {
+				bfqq->last_rais_start_finish = jiffies;
+				bfqq->raising_cur_max_time = raising_max_time;
+			}
+			bfq_log_bfqq(bfqd, bfqq,
+				     "wrais %s, coeff %u, dur %u msec",
+				     idle_for_long_time ? "interactive" :
+							  "soft rt",
+				     bfqq->raising_coeff,
+				     jiffies_to_msecs(
+					bfqq->raising_cur_max_time));
+		} else if (old_raising_coeff > 1 &&
+			   time_is_before_jiffies(
+				bfqq->last_rais_start_finish +
+				bfqq->raising_cur_max_time)) {
+			bfq_bfqq_end_raising(bfqq);
+			bfq_log_bfqq(bfqd, bfqq, "wrais ended on arrival");
+		}
 add_bfqq_busy:
 		bfq_add_bfqq_busy(bfqd, bfqq);
 	} else
 		bfq_updated_next_req(bfqd, bfqq);
 
- 	if (! bfqd->low_latency)
- 		return;
- 
- 	if(old_raising_coeff == 1 ||
- 	   (bfqd->bfq_raising_max_softrt_rate > 0 &&
- 		bfqq->soft_rt_next_start < jiffies))
- 		bfqq->last_rais_start_finish = jiffies;
+	/*
+	 * While not raised, last_rais_start_finish tracks the last
+	 * activity of the queue, and idle_for_long_time above is
+	 * measured from it.
+	 */
+	if (bfqd->low_latency && bfqq->raising_coeff == 1)
+		bfqq->last_rais_start_finish = jiffies;
 }
 
 static void bfq_reposition_rq_rb(struct bfq_queue *bfqq, struct request *rq)
@@ -1010,15 +1068,21 @@ static void bfq_bfqq_expire(struct bfq_data *bfqd,
 	if (bfqd->low_latency && bfqq->raising_coeff == 1)
 		bfqq->last_rais_start_finish = jiffies;
 
-	if (bfqd->low_latency && bfqd->bfq_raising_max_softrt_rate > 0) {
-	    if(reason != BFQ_BFQQ_BUDGET_TIMEOUT)
-		bfqq->soft_rt_next_start =
-			jiffies +
+	/*
+	 * A queue is soft real-time if, after emptying, it does not
+	 * come back before the time it would take to consume the
+	 * service it just received at bfq_raising_max_softrt_rate.
+	 * A queue that is still backlogged or that timed out is
+	 * greedy and is not considered soft real-time at all.
+	 */
+	if (bfqd->low_latency && bfqd->bfq_raising_max_softrt_rate > 0 &&
+	    bfq_bfqq_sync(bfqq) && RB_EMPTY_ROOT(&bfqq->sort_list) &&
+	    reason != BFQ_BFQQ_BUDGET_TIMEOUT)
+		bfqq->soft_rt_next_start = jiffies +
 			HZ * bfqq->entity.service /
 			bfqd->bfq_raising_max_softrt_rate;
-		else
-			bfqq->soft_rt_next_start = -1; /* infinity */
-	}
+	else
+		bfqq->soft_rt_next_start = bfq_infinity_from_now(jiffies);
 	bfq_log_bfqq(bfqd, bfqq,
 		"expire (%d, slow %d, num_disp %d, idle_win %d)", reason, slow,
 		bfqq->dispatched, bfq_bfqq_idle_window(bfqq));
@@ -1175,10 +1239,11 @@ static int __bfq_dispatch_requests(struct bfq_data *bfqd,
 			struct bfq_entity *entity = &bfqq->entity;
 
 			bfq_log_bfqq(bfqd, bfqq,
-				"raising period dur %llu/%lu msec, "
-				"old raising coeff %lu, w %lu(%lu)",
-				jiffies - bfqq->last_rais_start_finish,
-				bfqd->bfq_raising_max_time,
+				"raising period dur %u/%u msec, "
+				"old raising coeff %u, w %d(%d)",
+				jiffies_to_msecs(jiffies -
+					bfqq->last_rais_start_finish),
+				jiffies_to_msecs(bfqq->raising_cur_max_time),
 				bfqq->raising_coeff,
 				bfqq->entity.weight, bfqq->entity.orig_weight);
 
@@ -1191,12 +1256,10 @@ static int __bfq_dispatch_requests(struct bfq_data *bfqd,
 			 * If too much time has elapsed from the beginning
 			 * of this weight-raising period, stop it
 			 */
-			if (jiffies - bfqq->last_rais_start_finish >
-				bfqd->bfq_raising_max_time) {
-				bfqq->raising_coeff = 1;
-				bfqq->last_rais_start_finish = jiffies;
-
-				entity->ioprio_changed = 1;
+			if (time_is_before_jiffies(
+					bfqq->last_rais_start_finish +
+					bfqq->raising_cur_max_time)) {
+				bfq_bfqq_end_raising(bfqq);
 				__bfq_entity_update_weight_prio(
 					bfq_entity_service_tree(entity),
 					entity);
@@ -1505,9 +1568,15 @@ retry:
 		bfqq->max_budget = (2 * bfq_max_budget(bfqd)) / 3;
 		bfqq->pid = current->pid;
 
+		/*
+		 * Pretend the queue has been idle for long, so that a
+		 * newly started application gets its weight raised.
+		 */
 		bfqq->raising_coeff = 1;
-		bfqq->last_rais_start_finish = 0;
-		bfqq->soft_rt_next_start = -1;
+		bfqq->raising_cur_max_time = 0;
+		bfqq->last_rais_start_finish = jiffies -
+			bfqd->bfq_raising_min_idle_time - 1;
+		bfqq->soft_rt_next_start = bfq_infinity_from_now(jiffies);
 
 		bfq_log_bfqq(bfqd, bfqq, "allocated");
 	}
@@ -2156,6 +2225,7 @@ static void *bfq_init_queue(struct request_queue *q)
 
 	bfqd->bfq_raising_coeff = 20;
 	bfqd->bfq_raising_max_time = msecs_to_jiffies(7500);
+	bfqd->bfq_raising_rt_max_time = msecs_to_jiffies(300);
 	bfqd->bfq_raising_min_idle_time = msecs_to_jiffies(2000);
 	bfqd->bfq_raising_max_softrt_rate = 7000;
 
@@ -2210,15 +2280,19 @@ static ssize_t bfq_weights_show(struct elevator_queue *e, char *page)
 
         num_char += sprintf(page + num_char, "Active:\n");
         list_for_each_entry(bfqq, &bfqd->active_list, bfqq_list) {
-                num_char += sprintf(page + num_char, "pid%d: weight %hu\n",
+                num_char += sprintf(page + num_char,
+			"pid%d: weight %hu, raising coeff %u\n",
 			bfqq->pid,
-			bfqq->entity.weight);
+			bfqq->entity.weight,
+			bfqq->raising_coeff);
         }
         num_char += sprintf(page + num_char, "Idle:\n");
         list_for_each_entry(bfqq, &bfqd->idle_list, bfqq_list) {
-                num_char += sprintf(page + num_char, "pid%d: weight %hu\n",
+                num_char += sprintf(page + num_char,
+			"pid%d: weight %hu, raising coeff %u\n",
 			bfqq->pid,
-			bfqq->entity.weight);
+			bfqq->entity.weight,
+			bfqq->raising_coeff);
         }
 	return num_char;
 }
@@ -2245,6 +2319,7 @@ SHOW_FUNCTION(bfq_timeout_async_show, bfqd->bfq_timeout[BLK_RW_ASYNC], 1);
 SHOW_FUNCTION(bfq_low_latency_show, bfqd->low_latency, 0);
 SHOW_FUNCTION(bfq_raising_coeff_show, bfqd->bfq_raising_coeff, 0);
 SHOW_FUNCTION(bfq_raising_max_time_show, bfqd->bfq_raising_max_time, 1);
+SHOW_FUNCTION(bfq_raising_rt_max_time_show, bfqd->bfq_raising_rt_max_time, 1);
 SHOW_FUNCTION(bfq_raising_min_idle_time_show, bfqd->bfq_raising_min_idle_time,
 	1);
 SHOW_FUNCTION(bfq_raising_max_softrt_rate_show,
@@ -2285,6 +2360,8 @@ STORE_FUNCTION(bfq_raising_coeff_store, &bfqd->bfq_raising_coeff, 1,
  		INT_MAX, 0);
 STORE_FUNCTION(bfq_raising_max_time_store, &bfqd->bfq_raising_max_time, 0,
  		INT_MAX, 1);
+STORE_FUNCTION(bfq_raising_rt_max_time_store, &bfqd->bfq_raising_rt_max_time, 0,
+		INT_MAX, 1);
 STORE_FUNCTION(bfq_raising_min_idle_time_store,
  	       &bfqd->bfq_raising_min_idle_time, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_raising_max_softrt_rate_store,
@@ -2356,6 +2433,19 @@ static ssize_t bfq_low_latency_store(struct elevator_queue *e,
 
 	if (__data > 1)
 		__data = 1;
+	if (__data == 0 && bfqd->low_latency) {
+		struct bfq_queue *bfqq;
+
+		/* Drop any weight raising still in progress. */
+		spin_lock_irq(bfqd->queue->queue_lock);
+		list_for_each_entry(bfqq, &bfqd->active_list, bfqq_list)
+			if (bfqq->raising_coeff > 1)
+				bfq_bfqq_end_raising(bfqq);
+		list_for_each_entry(bfqq, &bfqd->idle_list, bfqq_list)
+			if (bfqq->raising_coeff > 1)
+				bfq_bfqq_end_raising(bfqq);
+		spin_unlock_irq(bfqd->queue->queue_lock);
+	}
 	bfqd->low_latency = __data;
 
 	return ret;
@@ -2378,6 +2468,7 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(low_latency),
 	BFQ_ATTR(raising_coeff),
 	BFQ_ATTR(raising_max_time),
+	BFQ_ATTR(raising_rt_max_time),
 	BFQ_ATTR(raising_min_idle_time),
 	BFQ_ATTR(raising_max_softrt_rate),
 	BFQ_ATTR(weights),
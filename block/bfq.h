@@ -209,7 +209,10 @@ struct bfq_group;
  *               without service-domain guarantees).
  * @bfq_raising_coeff: Maximum factor by which the weight of a boosted
  *                            queue is multiplied
- * @bfq_raising_max_time: maximum duration of a weight-raising period (jiffies)
+ * @bfq_raising_max_time: maximum duration of a weight-raising period for
+ *			  an interactive queue (jiffies)
+ * @bfq_raising_rt_max_time: maximum duration of a weight-raising period for
+ *			     a soft real-time queue (jiffies)
  * @bfq_raising_min_idle_time: minimum idle period after which weight-raising
  *			       may be reactivated for a queue (in jiffies)
  * @bfq_raising_max_softrt_rate: max service-rate for a soft real-time queue,
@@ -269,6 +272,7 @@ struct bfq_data {
 	/* parameters of the low_latency heuristics */
 	unsigned int bfq_raising_coeff;
 	unsigned int bfq_raising_max_time;
+	unsigned int bfq_raising_rt_max_time;
 	unsigned int bfq_raising_min_idle_time;
 	unsigned int bfq_raising_max_softrt_rate;
 };
@@ -296,8 +300,12 @@ struct bfq_data {
  * @seek_mean: mean seek distance
  * @last_request_pos: position of the last request enqueued
  * @pid: pid of the process owning the queue, used for logging purposes.
- * @last_rais_start_time: last (idle -> weight-raised) transition attempt
- * @high_weight_budget: number of sectors left to serve with boosted weight
+ * @last_rais_start_finish: start of the current weight-raising period, or
+ *			    end of the last service slot if not raised.
+ * @soft_rt_next_start: earliest arrival time at which the queue is still
+ *			considered soft real-time.
+ * @raising_cur_max_time: duration of the current weight-raising period.
+ * @raising_coeff: current weight-raising factor, 1 if not raised.
  *
  * A bfq_queue is a leaf request queue; it can be associated to an io_context
  * or more (if it is an async one).  @cgroup holds a reference to the
@@ -338,9 +346,10 @@ struct bfq_queue {
 
 	pid_t pid;
 
-	/* weight-raising fileds */
- 	u64 last_rais_start_finish, soft_rt_next_start;
- 	unsigned int raising_coeff;
+	/* weight-raising fields */
+	unsigned long last_rais_start_finish, soft_rt_next_start;
+	unsigned long raising_cur_max_time;
+	unsigned int raising_coeff;
 };
 
 enum bfqq_state_flags {
@@ -17,6 +17,7 @@
 #include <linux/err.h>
 #include <linux/blkdev.h>
 #include <linux/slab.h>
+#include <linux/delayacct.h>
 #include "blk-cgroup.h"
 #include <linux/genhd.h>
 
@@ -328,6 +329,57 @@ void blkiocg_update_completion_stats(struct blkio_group *blkg,
 }
 EXPORT_SYMBOL_GPL(blkiocg_update_completion_stats);
 
+#ifdef CONFIG_BLK_IO_LATENCY
+/*
+ * Charge the latency of a completed request to the cgroup of the task
+ * which allocated it.  Called by the block layer with the queue lock
+ * held, possibly from interrupt context.
+ */
+void blkiocg_update_io_latency(struct task_struct *tsk, uint64_t wait_ns,
+				uint64_t service_ns)
+{
+	struct blkio_cgroup *blkcg;
+	unsigned long flags;
+
+	rcu_read_lock();
+	blkcg = container_of(task_subsys_state(tsk, blkio_subsys_id),
+			     struct blkio_cgroup, css);
+	spin_lock_irqsave(&blkcg->lat_lock, flags);
+	blkcg->wait_hist[delayacct_blkio_lat_bucket(wait_ns)]++;
+	blkcg->service_hist[delayacct_blkio_lat_bucket(service_ns)]++;
+	spin_unlock_irqrestore(&blkcg->lat_lock, flags);
+	rcu_read_unlock();
+}
+
+static void blkio_print_lat_hist(struct seq_file *m, const char *name,
+				 uint64_t *hist)
+{
+	int i;
+
+	seq_printf(m, "%s", name);
+	for (i = 0; i < TASKSTATS_BLKIO_LAT_BUCKETS; i++)
+		seq_printf(m, " %llu", (unsigned long long)hist[i]);
+	seq_printf(m, "\n");
+}
+
+static int blkiocg_io_latency_read(struct cgroup *cgroup, struct cftype *cft,
+				   struct seq_file *m)
+{
+	struct blkio_cgroup *blkcg = cgroup_to_blkio_cgroup(cgroup);
+	uint64_t wait[TASKSTATS_BLKIO_LAT_BUCKETS];
+	uint64_t service[TASKSTATS_BLKIO_LAT_BUCKETS];
+
+	spin_lock_irq(&blkcg->lat_lock);
+	memcpy(wait, blkcg->wait_hist, sizeof(wait));
+	memcpy(service, blkcg->service_hist, sizeof(service));
+	spin_unlock_irq(&blkcg->lat_lock);
+
+	blkio_print_lat_hist(m, "wait", wait);
+	blkio_print_lat_hist(m, "service", service);
+	return 0;
+}
+#endif
+
 void blkiocg_update_io_merged_stats(struct blkio_group *blkg, bool direction,
 					bool sync)
 {
@@ -498,6 +550,12 @@ blkiocg_reset_stats(struct cgroup *cgroup, struct cftype *cftype, u64 val)
 #endif
 		spin_unlock(&blkg->stats_lock);
 	}
+#ifdef CONFIG_BLK_IO_LATENCY
+	spin_lock(&blkcg->lat_lock);
+	memset(blkcg->wait_hist, 0, sizeof(blkcg->wait_hist));
+	memset(blkcg->service_hist, 0, sizeof(blkcg->service_hist));
+	spin_unlock(&blkcg->lat_lock);
+#endif
 	spin_unlock_irq(&blkcg->lock);
 	return 0;
 }
@@ -874,6 +932,12 @@ struct cftype blkio_files[] = {
 		.name = "reset_stats",
 		.write_u64 = blkiocg_reset_stats,
 	},
+#ifdef CONFIG_BLK_IO_LATENCY
+	{
+		.name = "io_latency",
+		.read_seq_string = blkiocg_io_latency_read,
+	},
+#endif
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "avg_queue_size",
@@ -976,6 +1040,9 @@ blkiocg_create(struct cgroup_subsys *subsys, struct cgroup *cgroup)
 done:
 	spin_lock_init(&blkcg->lock);
 	INIT_HLIST_HEAD(&blkcg->blkg_list);
+#ifdef CONFIG_BLK_IO_LATENCY
+	spin_lock_init(&blkcg->lat_lock);
+#endif
 
 	INIT_LIST_HEAD(&blkcg->policy_list);
 	return &blkcg->css;
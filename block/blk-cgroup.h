@@ -71,6 +71,16 @@ struct blkio_cgroup {
 	spinlock_t lock;
 	struct hlist_head blkg_list;
 	struct list_head policy_list; /* list of blkio_policy_node */
+#ifdef CONFIG_BLK_IO_LATENCY
+	/*
+	 * Latency histograms of the requests allocated by the tasks of
+	 * this cgroup, on any device.  Separate lock, as the queue lock
+	 * is held when they are updated and nests inside blkcg->lock.
+	 */
+	spinlock_t lat_lock;
+	uint64_t wait_hist[TASKSTATS_BLKIO_LAT_BUCKETS];
+	uint64_t service_hist[TASKSTATS_BLKIO_LAT_BUCKETS];
+#endif
 };
 
 struct blkio_group_stats {
@@ -255,4 +265,12 @@ static inline void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 static inline void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
 						bool direction, bool sync) {}
 #endif
+
+#if defined(CONFIG_BLK_CGROUP) && defined(CONFIG_BLK_IO_LATENCY)
+void blkiocg_update_io_latency(struct task_struct *tsk, uint64_t wait_ns,
+				uint64_t service_ns);
+#else
+static inline void blkiocg_update_io_latency(struct task_struct *tsk,
+				uint64_t wait_ns, uint64_t service_ns) {}
+#endif
 #endif /* _BLK_CGROUP_H */
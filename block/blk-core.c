@@ -27,11 +27,13 @@
 #include <linux/writeback.h>
 #include <linux/task_io_accounting_ops.h>
 #include <linux/fault-inject.h>
+#include <linux/delayacct.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/block.h>
 
 #include "blk.h"
+#include "blk-cgroup.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -647,6 +649,9 @@ static inline void blk_free_request(struct request_queue *q, struct request *rq)
 {
 	if (rq->cmd_flags & REQ_ELVPRIV)
 		elv_put_request(q, rq);
+#ifdef CONFIG_BLK_IO_LATENCY
+	put_task_struct(rq->io_task);
+#endif
 	mempool_free(rq, q->rq.rq_pool);
 }
 
@@ -670,6 +675,10 @@ blk_alloc_request(struct request_queue *q, int flags, int priv, gfp_t gfp_mask)
 		rq->cmd_flags |= REQ_ELVPRIV;
 	}
 
+#ifdef CONFIG_BLK_IO_LATENCY
+	get_task_struct(current);
+	rq->io_task = current;
+#endif
 	return rq;
 }
 
@@ -1774,6 +1783,34 @@ static void blk_account_io_done(struct request *req)
 	}
 }
 
+#ifdef CONFIG_BLK_IO_LATENCY
+/*
+ * Charge the time @req spent queued and the time it spent in the
+ * driver to the task which allocated it and to that task's cgroup.
+ * Requests which never went through blk_start_request() are skipped.
+ */
+static void blk_account_io_latency(struct request *req)
+{
+	u64 now, wait_ns = 0, service_ns = 0;
+
+	if (!req->io_task || !req->io_start_time_ns)
+		return;
+
+	now = sched_clock();
+	if (time_after64(req->io_start_time_ns, req->start_time_ns))
+		wait_ns = req->io_start_time_ns - req->start_time_ns;
+	if (time_after64(now, req->io_start_time_ns))
+		service_ns = now - req->io_start_time_ns;
+
+	delayacct_blkio_latency(req->io_task, wait_ns, service_ns);
+	blkiocg_update_io_latency(req->io_task, wait_ns, service_ns);
+}
+#else
+static inline void blk_account_io_latency(struct request *req)
+{
+}
+#endif
+
 /**
  * blk_peek_request - peek at the top of a request queue
  * @q: request queue to peek at
@@ -2138,6 +2175,7 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	blk_account_io_latency(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -2540,7 +2578,7 @@ int __init blk_dev_init(void)
 	BUILD_BUG_ON(__REQ_NR_BITS > 8 *
 			sizeof(((struct request *)0)->cmd_flags));
 
-	kblockd_workqueue = create_workqueue("kblockd");
+	kblockd_workqueue = alloc_workqueue("kblockd", WQ_RESCUER, 1);
 	if (!kblockd_workqueue)
 		panic("Failed to create kblockd\n");
 
@@ -0,0 +1,456 @@
+/*
+ *  Simple IO scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ *
+ *  Meant for flash and other non-rotational devices, where seeking costs
+ *  nothing and idling or sorting by sector only adds latency.  Requests
+ *  are kept in pure FIFO order, on separate lists for sync and async
+ *  reads and writes.  Reads are preferred over writes, sync requests over
+ *  async ones, and per-list expire times and a writes_starved limit keep
+ *  any list from being starved for good.  There is no idling.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/rbtree.h>
+
+enum { ASYNC, SYNC };
+
+/*
+ * See Documentation/block/sio-iosched.txt
+ */
+static const int sync_read_expire = HZ / 8;	/* max time before a sync read is submitted. */
+static const int sync_write_expire = HZ / 2;	/* max time before a sync write is submitted. */
+static const int async_read_expire = HZ;	/* ditto for async, these limits are SOFT! */
+static const int async_write_expire = 4 * HZ;
+static const int writes_starved = 2;		/* max times reads can starve a write */
+static const int fifo_batch = 8;		/* # of requests dispatched in one direction
+						   before switching */
+
+struct sio_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are on one fifo_list, indexed by [sync][data_dir], and
+	 * on the sort_list of their data direction, which is only used to
+	 * find front merges
+	 */
+	struct list_head fifo_list[2][2];
+	struct rb_root sort_list[2];
+
+	int batch_dir;			/* direction of the current batch */
+	unsigned int batching;		/* number of requests in this batch */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2][2];
+	int fifo_batch;
+	int writes_starved;
+	int front_merges;
+};
+
+static inline struct list_head *
+sio_fifo_list(struct sio_data *sd, struct request *rq)
+{
+	return &sd->fifo_list[rq_is_sync(rq)][rq_data_dir(rq)];
+}
+
+static inline struct rb_root *
+sio_rb_root(struct sio_data *sd, struct request *rq)
+{
+	return &sd->sort_list[rq_data_dir(rq)];
+}
+
+static void sio_move_to_dispatch(struct sio_data *sd, struct request *rq);
+
+static void
+sio_add_rq_rb(struct sio_data *sd, struct request *rq)
+{
+	struct rb_root *root = sio_rb_root(sd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		sio_move_to_dispatch(sd, __alias);
+}
+
+/*
+ * add rq to the rbtree and to the tail of its fifo
+ */
+static void
+sio_add_request(struct request_queue *q, struct request *rq)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+	const int data_dir = rq_data_dir(rq);
+
+	sio_add_rq_rb(sd, rq);
+
+	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[sync][data_dir]);
+	list_add_tail(&rq->queuelist, &sd->fifo_list[sync][data_dir]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void sio_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	elv_rb_del(sio_rb_root(sd, rq), rq);
+}
+
+static int
+sio_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * back merges are found by the elevator core through its hash,
+	 * check for a front merge
+	 */
+	if (sd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&sd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void sio_merged_request(struct request_queue *q,
+			       struct request *req, int type)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(sio_rb_root(sd, req), req);
+		sio_add_rq_rb(sd, req);
+	}
+}
+
+static void
+sio_merged_requests(struct request_queue *q, struct request *req,
+		    struct request *next)
+{
+	/*
+	 * if next expires before rq and both sit on the same fifo,
+	 * assign its expire time to rq and move into next position
+	 * (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    rq_is_sync(req) == rq_is_sync(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	sio_remove_request(q, next);
+}
+
+/*
+ * move request from the fifo and rbtree to the dispatch queue.
+ */
+static void sio_move_to_dispatch(struct sio_data *sd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	sio_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * return the head of the fifo if it has expired, NULL otherwise
+ */
+static inline struct request *
+sio_expired_request(struct sio_data *sd, int sync, int data_dir)
+{
+	struct list_head *list = &sd->fifo_list[sync][data_dir];
+	struct request *rq;
+
+	if (list_empty(list))
+		return NULL;
+
+	rq = rq_entry_fifo(list->next);
+	if (time_after(jiffies, rq_fifo_time(rq)))
+		return rq;
+
+	return NULL;
+}
+
+/*
+ * pick the next request of data_dir: an expired async request first,
+ * as its expire time is the longest, then an expired sync one, then
+ * the oldest sync request and finally the oldest async one.
+ */
+static struct request *sio_choose_request(struct sio_data *sd, int data_dir)
+{
+	struct list_head *sync = &sd->fifo_list[SYNC][data_dir];
+	struct list_head *async = &sd->fifo_list[ASYNC][data_dir];
+	struct request *rq;
+
+	rq = sio_expired_request(sd, ASYNC, data_dir);
+	if (rq)
+		return rq;
+	rq = sio_expired_request(sd, SYNC, data_dir);
+	if (rq)
+		return rq;
+
+	if (!list_empty(sync))
+		return rq_entry_fifo(sync->next);
+	if (!list_empty(async))
+		return rq_entry_fifo(async->next);
+
+	return NULL;
+}
+
+static inline int sio_dir_empty(struct sio_data *sd, int data_dir)
+{
+	return list_empty(&sd->fifo_list[SYNC][data_dir]) &&
+		list_empty(&sd->fifo_list[ASYNC][data_dir]);
+}
+
+/*
+ * sio_dispatch_requests selects the best request according to
+ * read/write preference, expire times, fifo_batch, etc
+ */
+static int sio_dispatch_requests(struct request_queue *q, int force)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	const int reads = !sio_dir_empty(sd, READ);
+	const int writes = !sio_dir_empty(sd, WRITE);
+	struct request *rq;
+	int data_dir;
+
+	/*
+	 * keep going in the current direction while the batch lasts,
+	 * unless a sync read showed up behind a batch of writes
+	 */
+	if (sd->batching < sd->fifo_batch && !sio_dir_empty(sd, sd->batch_dir) &&
+	    !(sd->batch_dir == WRITE &&
+	      !list_empty(&sd->fifo_list[SYNC][READ]))) {
+		data_dir = sd->batch_dir;
+		goto dispatch_request;
+	}
+
+	/*
+	 * at this point we are not running a batch. select the appropriate
+	 * data direction (read / write)
+	 */
+	if (reads) {
+		if (writes && (sd->starved++ >= sd->writes_starved))
+			goto dispatch_writes;
+
+		data_dir = READ;
+		goto dispatch_new_batch;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+	if (writes) {
+dispatch_writes:
+		sd->starved = 0;
+		data_dir = WRITE;
+		goto dispatch_new_batch;
+	}
+
+	return 0;
+
+dispatch_new_batch:
+	sd->batch_dir = data_dir;
+	sd->batching = 0;
+
+dispatch_request:
+	rq = sio_choose_request(sd, data_dir);
+	BUG_ON(!rq);
+
+	sd->batching++;
+	sio_move_to_dispatch(sd, rq);
+
+	return 1;
+}
+
+static int sio_queue_empty(struct request_queue *q)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	return sio_dir_empty(sd, READ) && sio_dir_empty(sd, WRITE);
+}
+
+static void sio_exit_queue(struct elevator_queue *e)
+{
+	struct sio_data *sd = e->elevator_data;
+
+	BUG_ON(!sio_dir_empty(sd, READ));
+	BUG_ON(!sio_dir_empty(sd, WRITE));
+
+	kfree(sd);
+}
+
+/*
+ * initialize elevator private data (sio_data).
+ */
+static void *sio_init_queue(struct request_queue *q)
+{
+	struct sio_data *sd;
+
+	sd = kmalloc_node(sizeof(*sd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!sd)
+		return NULL;
+
+	INIT_LIST_HEAD(&sd->fifo_list[SYNC][READ]);
+	INIT_LIST_HEAD(&sd->fifo_list[SYNC][WRITE]);
+	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][READ]);
+	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][WRITE]);
+	sd->sort_list[READ] = RB_ROOT;
+	sd->sort_list[WRITE] = RB_ROOT;
+	sd->batch_dir = READ;
+	sd->fifo_expire[SYNC][READ] = sync_read_expire;
+	sd->fifo_expire[SYNC][WRITE] = sync_write_expire;
+	sd->fifo_expire[ASYNC][READ] = async_read_expire;
+	sd->fifo_expire[ASYNC][WRITE] = async_write_expire;
+	sd->writes_starved = writes_starved;
+	sd->front_merges = 1;
+	sd->fifo_batch = fifo_batch;
+	return sd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+sio_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+sio_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct sio_data *sd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return sio_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(sio_sync_read_expire_show, sd->fifo_expire[SYNC][READ], 1);
+SHOW_FUNCTION(sio_sync_write_expire_show, sd->fifo_expire[SYNC][WRITE], 1);
+SHOW_FUNCTION(sio_async_read_expire_show, sd->fifo_expire[ASYNC][READ], 1);
+SHOW_FUNCTION(sio_async_write_expire_show, sd->fifo_expire[ASYNC][WRITE], 1);
+SHOW_FUNCTION(sio_writes_starved_show, sd->writes_starved, 0);
+SHOW_FUNCTION(sio_front_merges_show, sd->front_merges, 0);
+SHOW_FUNCTION(sio_fifo_batch_show, sd->fifo_batch, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct sio_data *sd = e->elevator_data;				\
+	int __data;							\
+	int ret = sio_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(sio_sync_read_expire_store, &sd->fifo_expire[SYNC][READ], 0, INT_MAX, 1);
+STORE_FUNCTION(sio_sync_write_expire_store, &sd->fifo_expire[SYNC][WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(sio_async_read_expire_store, &sd->fifo_expire[ASYNC][READ], 0, INT_MAX, 1);
+STORE_FUNCTION(sio_async_write_expire_store, &sd->fifo_expire[ASYNC][WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(sio_writes_starved_store, &sd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(sio_front_merges_store, &sd->front_merges, 0, 1, 0);
+STORE_FUNCTION(sio_fifo_batch_store, &sd->fifo_batch, 1, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define SIO_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, sio_##name##_show, sio_##name##_store)
+
+static struct elv_fs_entry sio_attrs[] = {
+	SIO_ATTR(sync_read_expire),
+	SIO_ATTR(sync_write_expire),
+	SIO_ATTR(async_read_expire),
+	SIO_ATTR(async_write_expire),
+	SIO_ATTR(writes_starved),
+	SIO_ATTR(front_merges),
+	SIO_ATTR(fifo_batch),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_sio = {
+	.ops = {
+		.elevator_merge_fn = 		sio_merge,
+		.elevator_merged_fn =		sio_merged_request,
+		.elevator_merge_req_fn =	sio_merged_requests,
+		.elevator_dispatch_fn =		sio_dispatch_requests,
+		.elevator_add_req_fn =		sio_add_request,
+		.elevator_queue_empty_fn =	sio_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		sio_init_queue,
+		.elevator_exit_fn =		sio_exit_queue,
+	},
+
+	.elevator_attrs = sio_attrs,
+	.elevator_name = "sio",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init sio_init(void)
+{
+	elv_register(&iosched_sio);
+
+	return 0;
+}
+
+static void __exit sio_exit(void)
+{
+	elv_unregister(&iosched_sio);
+}
+
+module_init(sio_init);
+module_exit(sio_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Simple IO scheduler");
@@ -0,0 +1,106 @@
+/*
+ * Shared per-CPU compression transforms
+ *
+ * Users such as zram and ramzswap compress single pages with preemption
+ * disabled and have no use for a transform of their own.  The transforms
+ * of an algorithm are allocated on first use, one per possible CPU, and
+ * freed when the last user goes away.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/percpu_comp.h>
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+static DEFINE_MUTEX(percpu_comp_mutex);
+static LIST_HEAD(percpu_comp_list);
+
+static void percpu_comp_destroy(struct crypto_percpu_comp *pc)
+{
+	struct crypto_comp *tfm;
+	int cpu;
+
+	if (pc->tfms) {
+		for_each_possible_cpu(cpu) {
+			tfm = *per_cpu_ptr(pc->tfms, cpu);
+			if (tfm)
+				crypto_free_comp(tfm);
+		}
+		free_percpu(pc->tfms);
+	}
+	kfree(pc);
+}
+
+/**
+ * crypto_alloc_percpu_comp() - Get the shared transforms of an algorithm
+ * @alg_name: Name of the compression algorithm, e.g. "lzo".
+ *
+ * Returns the transforms, allocating them if this is the first user, or
+ * an ERR_PTR.  Must be balanced with crypto_free_percpu_comp().
+ */
+struct crypto_percpu_comp *crypto_alloc_percpu_comp(const char *alg_name)
+{
+	struct crypto_percpu_comp *pc;
+	struct crypto_comp *tfm;
+	int cpu, err;
+
+	mutex_lock(&percpu_comp_mutex);
+	list_for_each_entry(pc, &percpu_comp_list, list) {
+		if (!strcmp(pc->name, alg_name)) {
+			pc->users++;
+			goto out;
+		}
+	}
+
+	err = -ENOMEM;
+	pc = kzalloc(sizeof(*pc), GFP_KERNEL);
+	if (!pc)
+		goto err;
+	strlcpy(pc->name, alg_name, sizeof(pc->name));
+	pc->users = 1;
+	pc->tfms = alloc_percpu(struct crypto_comp *);
+	if (!pc->tfms)
+		goto err_free;
+
+	for_each_possible_cpu(cpu) {
+		tfm = crypto_alloc_comp(alg_name, 0, CRYPTO_ALG_ASYNC);
+		if (IS_ERR(tfm)) {
+			err = PTR_ERR(tfm);
+			goto err_free;
+		}
+		*per_cpu_ptr(pc->tfms, cpu) = tfm;
+	}
+	list_add(&pc->list, &percpu_comp_list);
+out:
+	mutex_unlock(&percpu_comp_mutex);
+	return pc;
+
+err_free:
+	percpu_comp_destroy(pc);
+err:
+	mutex_unlock(&percpu_comp_mutex);
+	return ERR_PTR(err);
+}
+EXPORT_SYMBOL_GPL(crypto_alloc_percpu_comp);
+
+void crypto_free_percpu_comp(struct crypto_percpu_comp *pc)
+{
+	mutex_lock(&percpu_comp_mutex);
+	if (!--pc->users) {
+		list_del(&pc->list);
+		percpu_comp_destroy(pc);
+	}
+	mutex_unlock(&percpu_comp_mutex);
+}
+EXPORT_SYMBOL_GPL(crypto_free_percpu_comp);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Shared per-CPU compression transforms");
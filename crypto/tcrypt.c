@@ -26,6 +26,7 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/slab.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -711,6 +712,165 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Fill a page with data which compresses about as well as the anonymous
+ * memory zram and ramzswap see: runs of zeroes, small integers and text.
+ */
+static void test_comp_fill(u8 *p, unsigned int len)
+{
+	static const char words[][8] = {
+		"the page", "kernel  ", "struct s", "swap ent", "data 123",
+		"\0\0\0\0\0\0\0\0", "\0\0\0\0\0\0\0\0",
+		"\1\0\0\0\0\0\0\0", "\xff\xff\xff\xff\0\0\0\0",
+	};
+	u32 seed = 1;
+	unsigned int n;
+
+	while (len) {
+		seed = seed * 1103515245 + 12345;
+		n = min_t(unsigned int, len, sizeof(words[0]));
+		memcpy(p, words[(seed >> 16) % ARRAY_SIZE(words)], n);
+		p += n;
+		len -= n;
+	}
+}
+
+static int test_comp_op(struct crypto_comp *tfm, int comp, const u8 *src,
+			unsigned int slen, u8 *dst, unsigned int dsize)
+{
+	unsigned int dlen = dsize;
+
+	if (comp)
+		return crypto_comp_compress(tfm, src, slen, dst, &dlen);
+	return crypto_comp_decompress(tfm, src, slen, dst, &dlen);
+}
+
+static int test_comp_jiffies(struct crypto_comp *tfm, int comp, const u8 *src,
+			     unsigned int slen, u8 *dst, unsigned int dsize,
+			     int sec)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = test_comp_op(tfm, comp, src, slen, dst, dsize);
+		if (ret)
+			return ret;
+	}
+
+	printk("%d pages in %d seconds (%ld bytes)\n",
+	       bcount, sec, (long)bcount * PAGE_SIZE);
+	return 0;
+}
+
+static int test_comp_cycles(struct crypto_comp *tfm, int comp, const u8 *src,
+			    unsigned int slen, u8 *dst, unsigned int dsize)
+{
+	unsigned long cycles = 0;
+	int ret = 0;
+	int i;
+
+	local_bh_disable();
+	local_irq_disable();
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = test_comp_op(tfm, comp, src, slen, dst, dsize);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = test_comp_op(tfm, comp, src, slen, dst, dsize);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	local_irq_enable();
+	local_bh_enable();
+
+	if (ret == 0)
+		printk("1 page in %lu cycles, %lu cycles/byte\n",
+		       (cycles + 4) / 8, (cycles + 4) / (8 * PAGE_SIZE));
+
+	return ret;
+}
+
+/* Compression and decompression of single pages, as zram and ramzswap do */
+static void test_comp_speed(const char *algo, unsigned int sec)
+{
+	struct crypto_comp *tfm;
+	unsigned int clen, dlen;
+	u8 *page = tvmem[0], *out = tvmem[1], *cbuf;
+	int ret;
+
+	printk(KERN_INFO "\ntesting speed of %s page compression\n", algo);
+
+	tfm = crypto_alloc_comp(algo, 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	/* Room for incompressible data, which some algorithms expand */
+	cbuf = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	if (!cbuf)
+		goto out;
+
+	test_comp_fill(page, PAGE_SIZE);
+	clen = 2 * PAGE_SIZE;
+	ret = crypto_comp_compress(tfm, page, PAGE_SIZE, cbuf, &clen);
+	if (ret) {
+		pr_err("compression failed ret=%d\n", ret);
+		goto out_free;
+	}
+	dlen = PAGE_SIZE;
+	ret = crypto_comp_decompress(tfm, cbuf, clen, out, &dlen);
+	if (ret || dlen != PAGE_SIZE || memcmp(page, out, PAGE_SIZE)) {
+		pr_err("decompression failed ret=%d\n", ret);
+		goto out_free;
+	}
+	pr_info("%lu bytes compress to %u bytes\n", PAGE_SIZE, clen);
+
+	pr_info("compression: ");
+	if (sec)
+		ret = test_comp_jiffies(tfm, 1, page, PAGE_SIZE, cbuf,
+					2 * PAGE_SIZE, sec);
+	else
+		ret = test_comp_cycles(tfm, 1, page, PAGE_SIZE, cbuf,
+				       2 * PAGE_SIZE);
+	if (ret) {
+		pr_err("compression failed ret=%d\n", ret);
+		goto out_free;
+	}
+
+	pr_info("decompression: ");
+	if (sec)
+		ret = test_comp_jiffies(tfm, 0, cbuf, clen, out, PAGE_SIZE,
+					sec);
+	else
+		ret = test_comp_cycles(tfm, 0, cbuf, clen, out, PAGE_SIZE);
+	if (ret)
+		pr_err("decompression failed ret=%d\n", ret);
+
+out_free:
+	kfree(cbuf);
+out:
+	crypto_free_comp(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1215,6 +1375,20 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 500:
+		/* fall through */
+
+	case 501:
+		test_comp_speed("lzo", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 502:
+		test_comp_speed("deflate", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 599:
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -730,8 +730,8 @@ static int __init cpufreq_smartass_init(void)
         }
 
         /* Scale up is high priority */
-        up_wq = create_rt_workqueue("ksmartass_up");
-        down_wq = create_workqueue("ksmartass_down");
+        up_wq = alloc_workqueue("ksmartass_up", WQ_HIGHPRI, 1);
+        down_wq = alloc_workqueue("ksmartass_down", 0, 1);
 
         INIT_WORK(&freq_scale_work, cpufreq_smartass_freq_change_time_work);
 
@@ -1194,13 +1194,15 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		cc->iv_mode = NULL;
 
 #ifndef CONFIG_DM_CRYPT_GLOBAL_WORKQUEUES
-	cc->io_queue = create_singlethread_workqueue("kcryptd_io");
+	cc->io_queue = alloc_workqueue("kcryptd_io",
+				       WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!cc->io_queue) {
 		ti->error = "Couldn't create kcryptd io queue";
 		goto bad_io_queue;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	cc->crypt_queue = alloc_workqueue("kcryptd",
+					  WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		destroy_workqueue(cc->io_queue);
@@ -1432,13 +1434,13 @@ static int __init dm_crypt_init(void)
 	int r;
 
 #ifdef CONFIG_DM_CRYPT_GLOBAL_WORKQUEUES
-	_io_queue = create_singlethread_workqueue("kcryptd_io");
+	_io_queue = alloc_workqueue("kcryptd_io", WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!_io_queue) {
 		DMERR("couldn't create kcryptd io queue");
 		return -ENOMEM;
 	}
 
-	_crypt_queue = create_singlethread_workqueue("kcryptd");
+	_crypt_queue = alloc_workqueue("kcryptd", WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!_crypt_queue) {
 		DMERR("couldn't create kcryptd queue");
 		destroy_workqueue(_io_queue);
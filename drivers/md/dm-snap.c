@@ -2277,7 +2277,7 @@ static int __init dm_snapshot_init(void)
 		goto bad_tracked_chunk_cache;
 	}
 
-	ksnapd = create_singlethread_workqueue("ksnapd");
+	ksnapd = alloc_workqueue("ksnapd", WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!ksnapd) {
 		DMERR("Failed to create ksnapd workqueue.");
 		r = -ENOMEM;
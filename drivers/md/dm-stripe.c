@@ -361,7 +361,7 @@ int __init dm_stripe_init(void)
 		return r;
 	}
 
-	kstriped = create_singlethread_workqueue("kstriped");
+	kstriped = alloc_workqueue("kstriped", WQ_UNBOUND | WQ_RESCUER, 1);
 	if (!kstriped) {
 		DMERR("failed to create workqueue kstriped");
 		dm_unregister_target(&stripe_target);
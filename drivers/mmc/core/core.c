@@ -1534,7 +1534,7 @@ static int __init mmc_init(void)
 {
 	int ret;
 
-	workqueue = create_singlethread_workqueue("kmmcd");
+	workqueue = alloc_workqueue("kmmcd", WQ_UNBOUND, 1);
 	if (!workqueue)
 		return -ENOMEM;
 
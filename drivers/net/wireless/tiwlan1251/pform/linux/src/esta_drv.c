@@ -1647,7 +1647,8 @@ tiwlan_create_drv(unsigned long reg_start, unsigned long reg_size,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,20)
     drv->tiwlan_wq = create_singlethread_workqueue("tiwlan_wifi_wq");
 #else
-    drv->tiwlan_wq = create_freezeable_workqueue("tiwlan_wifi_wq");
+    drv->tiwlan_wq = alloc_workqueue("tiwlan_wifi_wq",
+                                     WQ_FREEZEABLE | WQ_UNBOUND, 1);
 #endif
     if( !(drv->tiwlan_wq) ) {
         tiwlan_free_drv(drv);
@@ -4223,7 +4223,7 @@ static int __init binder_init(void)
 {
 	int ret;
 
-	binder_deferred_workqueue = create_singlethread_workqueue("binder");
+	binder_deferred_workqueue = alloc_workqueue("binder", WQ_UNBOUND, 1);
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
 
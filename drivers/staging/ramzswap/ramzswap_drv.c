@@ -23,13 +23,13 @@
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
-#include <linux/lzo.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
 #include <linux/vmalloc.h>
 #include <linux/version.h>
+#include <crypto/percpu_comp.h>
 
 #include "compat.h"
 #include "ramzswap_drv.h"
@@ -39,6 +39,7 @@ static unsigned int num_devices;
 static unsigned long disksize_kb;
 static unsigned long memlimit_kb;
 static char backing_swap[MAX_SWAP_NAME_LEN];
+static char *compressor = "lzo";
 
 /* Globals */
 static int ramzswap_major;
@@ -750,7 +751,7 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 {
 	int ret;
 	u32 index;
-	size_t clen;
+	unsigned int clen;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem;
@@ -777,7 +778,7 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
 			rzs->table[index].offset;
 
-	ret = lzo1x_decompress_safe(
+	ret = crypto_percpu_comp_decompress(rzs->comp,
 		cmem + sizeof(*zheader),
 		xv_get_object_size(cmem) - sizeof(*zheader),
 		user_mem, &clen);
@@ -786,7 +787,7 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 	kunmap_atomic(cmem, KM_USER1);
 
 	/* should NEVER happen */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n",
 			ret, index);
 		stat64_inc(rzs, &rzs->stats.failed_reads);
@@ -808,7 +809,7 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 {
 	int ret, fwd_write_request = 0;
 	u32 offset, index;
-	size_t clen;
+	unsigned int clen;
 	struct zobj_header *zheader;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src;
@@ -852,12 +853,14 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-				rzs->compress_workmem);
+	/* compress_buffer is two pages, room for what lzo may expand to */
+	clen = 2 * PAGE_SIZE;
+	ret = crypto_percpu_comp_compress(rzs->comp, user_mem, PAGE_SIZE,
+					  src, &clen);
 
 	kunmap_atomic(user_mem, KM_USER0);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		mutex_unlock(&rzs->lock);
 		pr_err("Compression failed! err=%d\n", ret);
 		stat64_inc(rzs, &rzs->stats.failed_writes);
@@ -900,7 +903,7 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 			GFP_NOIO | __GFP_HIGHMEM)) {
 		mutex_unlock(&rzs->lock);
 		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
+			"page: %u, size=%u\n", index, clen);
 		stat64_inc(rzs, &rzs->stats.failed_writes);
 		if (rzs->backing_swap)
 			fwd_write_request = 1;
@@ -1040,10 +1043,11 @@ static void reset_device(struct ramzswap *rzs, struct block_device *bdev)
 	num_pages = rzs->disksize >> PAGE_SHIFT;
 
 	/* Free various per-device buffers */
-	kfree(rzs->compress_workmem);
+	if (rzs->comp)
+		crypto_free_percpu_comp(rzs->comp);
 	free_pages((unsigned long)rzs->compress_buffer, 1);
 
-	rzs->compress_workmem = NULL;
+	rzs->comp = NULL;
 	rzs->compress_buffer = NULL;
 
 	/* Free all pages that are still in this ramzswap device */
@@ -1133,10 +1137,11 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 	else
 		ramzswap_set_disksize(rzs, totalram_pages << PAGE_SHIFT);
 
-	rzs->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!rzs->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
+	rzs->comp = crypto_alloc_percpu_comp(compressor);
+	if (IS_ERR(rzs->comp)) {
+		pr_err("Error allocating %s compressor!\n", compressor);
+		ret = PTR_ERR(rzs->comp);
+		rzs->comp = NULL;
 		goto fail;
 	}
 
@@ -1552,6 +1557,10 @@ MODULE_PARM_DESC(memlimit_kb, "Memlimit in KB");
 module_param_string(backing_swap, backing_swap, sizeof(backing_swap), 0);
 MODULE_PARM_DESC(backing_swap, "Backing swap name");
 
+/* Optional: default = lzo, shared with zram */
+module_param(compressor, charp, 0444);
+MODULE_PARM_DESC(compressor, "Compression algorithm of new devices");
+
 module_init(ramzswap_init);
 module_exit(ramzswap_exit);
 
@@ -130,7 +130,7 @@ struct ramzswap_stats {
 
 struct ramzswap {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
+	struct crypto_percpu_comp *comp; /* shared per-CPU compressor */
 	void *compress_buffer;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
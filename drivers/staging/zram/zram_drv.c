@@ -29,9 +29,9 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <crypto/percpu_comp.h>
 
 #include "zram_drv.h"
 
@@ -41,6 +41,7 @@ struct zram *zram_devices;
 
 /* Module params (documentation at end) */
 unsigned int zram_num_devices;
+static char *zram_compressor = "lzo";
 
 static void zram_stat_inc(u32 *v)
 {
@@ -214,7 +215,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	unsigned int clen;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
@@ -257,9 +258,10 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
 		zram->table[index].offset;
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    uncmem, &clen);
+	ret = crypto_percpu_comp_decompress(zram->comp,
+			cmem + sizeof(*zheader),
+			xv_get_object_size(cmem) - sizeof(*zheader),
+			uncmem, &clen);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -271,7 +273,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	kunmap_atomic(user_mem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -285,7 +287,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
+	unsigned int clen = PAGE_SIZE;
 	struct zobj_header *zheader;
 	unsigned char *cmem;
 
@@ -305,13 +307,14 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    mem, &clen);
+	ret = crypto_percpu_comp_decompress(zram->comp,
+			cmem + sizeof(*zheader),
+			xv_get_object_size(cmem) - sizeof(*zheader),
+			mem, &clen);
 	kunmap_atomic(cmem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -325,7 +328,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret;
 	u32 store_offset;
-	size_t clen;
+	unsigned int clen;
 	struct zobj_header *zheader;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
@@ -377,14 +380,16 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	/* compress_buffer is two pages, room for what lzo may expand to */
+	clen = 2 * PAGE_SIZE;
+	ret = crypto_percpu_comp_compress(zram->comp, uncmem, PAGE_SIZE,
+					  src, &clen);
 
 	kunmap_atomic(user_mem, KM_USER0);
 	if (is_partial_io(bvec))
 			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -416,7 +421,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		      &zram->table[index].page, &store_offset,
 		      GFP_NOIO | __GFP_HIGHMEM)) {
 		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
+			"page: %u, size=%u\n", index, clen);
 		ret = -ENOMEM;
 		goto out;
 	}
@@ -591,10 +596,11 @@ void __zram_reset_device(struct zram *zram)
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
+	if (zram->comp)
+		crypto_free_percpu_comp(zram->comp);
 	free_pages((unsigned long)zram->compress_buffer, 1);
 
-	zram->compress_workmem = NULL;
+	zram->comp = NULL;
 	zram->compress_buffer = NULL;
 
 	/* Free all pages that are still in this zram device */
@@ -647,10 +653,11 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
+	zram->comp = crypto_alloc_percpu_comp(zram_compressor);
+	if (IS_ERR(zram->comp)) {
+		pr_err("Error allocating %s compressor!\n", zram_compressor);
+		ret = PTR_ERR(zram->comp);
+		zram->comp = NULL;
 		goto fail_no_table;
 	}
 
@@ -860,6 +867,8 @@ static void __exit zram_exit(void)
 
 module_param(zram_num_devices, uint, 0);
 MODULE_PARM_DESC(zram_num_devices, "Number of zram devices");
+module_param(zram_compressor, charp, 0444);
+MODULE_PARM_DESC(zram_compressor, "Compression algorithm of new devices");
 
 module_init(zram_init);
 module_exit(zram_exit);
@@ -103,7 +103,7 @@ struct zram_stats {
 
 struct zram {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
+	struct crypto_percpu_comp *comp; /* shared per-CPU compressor */
 	void *compress_buffer;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
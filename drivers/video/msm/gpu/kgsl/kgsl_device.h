@@ -216,7 +216,7 @@ kgsl_get_mmu(struct kgsl_device *device)
 static inline int kgsl_create_device_workqueue(struct kgsl_device *device)
 {
 	KGSL_DRV_INFO("creating workqueue: %s\n", device->name);
-	device->work_queue = create_workqueue(device->name);
+	device->work_queue = alloc_workqueue(device->name, 0, 1);
 	if (!device->work_queue) {
 		KGSL_DRV_ERR("Failed to create workqueue %s\n",
 				device->name);
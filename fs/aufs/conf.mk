@@ -14,6 +14,7 @@ AuConfAll = BRANCH_MAX_127 BRANCH_MAX_511 BRANCH_MAX_1023 BRANCH_MAX_32767 \
 	RDU \
 	SP_IATTR \
 	SHWH \
+	LCACHE \
 	BR_RAMFS \
 	BR_FUSE POLL \
 	BR_HFSPLUS \
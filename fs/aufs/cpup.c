@@ -530,6 +530,10 @@ int cpup_entry(struct dentry *dentry, aufs_bindex_t bdst,
 		au_xino_write(sb, bsrc, h_inode->i_ino, /*ino*/0);
 		/* ignore this error */
 
+	/* the entry may be found in another branch now */
+	if (!err)
+		au_lcache_reset(dst_parent->d_inode);
+
 	if (do_dt)
 		au_dtime_revert(&dt);
 	return err;
@@ -109,6 +109,24 @@ void au_vdir_free(struct au_vdir *vdir);
 int au_vdir_init(struct file *file);
 int au_vdir_fill_de(struct file *file, void *dirent, filldir_t filldir);
 
+/* lcache.c */
+struct au_lcache;
+#ifdef CONFIG_AUFS_LCACHE
+int au_lcache_lkup(struct dentry *dentry, struct dentry *parent,
+		   struct nameidata *nd, unsigned int *gen);
+void au_lcache_add(struct dentry *dentry, struct dentry *parent,
+		   int npositive, unsigned int gen);
+void au_lcache_reset(struct inode *dir);
+void au_lcache_free(struct au_lcache *lc);
+#else
+AuStub(int, au_lcache_lkup, return -1, struct dentry *dentry,
+       struct dentry *parent, struct nameidata *nd, unsigned int *gen)
+AuStubVoid(au_lcache_add, struct dentry *dentry, struct dentry *parent,
+	   int npositive, unsigned int gen)
+AuStubVoid(au_lcache_reset, struct inode *dir)
+AuStubVoid(au_lcache_free, struct au_lcache *lc)
+#endif
+
 /* ioctl.c */
 long aufs_ioctl_dir(struct file *file, unsigned int cmd, unsigned long arg);
 
@@ -544,6 +544,9 @@ int au_hnotify(struct inode *h_dir, struct au_hnotify *hnotify, u32 mask,
 	if (!dir)
 		goto out;
 
+	/* the cached lookups must not wait for the job */
+	au_lcache_reset(dir);
+
 	isroot = (dir->i_ino == AUFS_ROOT_INO);
 	wh = 0;
 	h_child_name = (void *)h_child_qstr->name;
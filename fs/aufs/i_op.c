@@ -160,6 +160,7 @@ static struct dentry *aufs_lookup(struct inode *dir, struct dentry *dentry,
 	struct inode *inode;
 	struct super_block *sb;
 	int err, npositive;
+	unsigned int lcgen;
 
 	IMustLock(dir);
 
@@ -184,8 +185,13 @@ static struct dentry *aufs_lookup(struct inode *dir, struct dentry *dentry,
 	if (!err)
 		err = au_digen_test(parent, au_sigen(sb));
 	if (!err) {
-		npositive = au_lkup_dentry(dentry, au_dbstart(parent),
-					   /*type*/0, nd);
+		npositive = au_lcache_lkup(dentry, parent, nd, &lcgen);
+		if (npositive < 0) {
+			npositive = au_lkup_dentry(dentry, au_dbstart(parent),
+						   /*type*/0, nd);
+			if (npositive >= 0)
+				au_lcache_add(dentry, parent, npositive, lcgen);
+		}
 		err = npositive;
 	}
 	di_read_unlock(parent, AuLock_IR);
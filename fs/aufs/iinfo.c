@@ -191,6 +191,7 @@ int au_iinfo_init(struct inode *inode)
 		iinfo->ii_bstart = -1;
 		iinfo->ii_bend = -1;
 		iinfo->ii_vdir = NULL;
+		iinfo->ii_lcache = NULL;
 		return 0;
 	}
 	return -ENOMEM;
@@ -247,6 +248,8 @@ void au_iinfo_fin(struct inode *inode)
 
 	if (iinfo->ii_vdir)
 		au_vdir_free(iinfo->ii_vdir);
+	if (iinfo->ii_lcache)
+		au_lcache_free(iinfo->ii_lcache);
 
 	bindex = iinfo->ii_bstart;
 	if (bindex >= 0) {
@@ -55,6 +55,7 @@ struct au_hinode {
 };
 
 struct au_vdir;
+struct au_lcache;
 struct au_iinfo {
 	atomic_t		ii_generation;
 	struct super_block	*ii_hsb1;	/* no get/put */
@@ -64,6 +65,7 @@ struct au_iinfo {
 	__u32			ii_higen;
 	struct au_hinode	*ii_hinode;
 	struct au_vdir		*ii_vdir;
+	struct au_lcache	*ii_lcache;
 };
 
 struct au_icntnr {
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2005-2011 Junjiro R. Okajima
+ *
+ * This program, aufs is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/*
+ * per-directory lookup cache
+ *
+ * A lookup of a name which is not in the top branch costs one lookup (and
+ * one whiteout test) in every branch above the one which has it, and a
+ * name which is nowhere costs them in all branches.  This cache remembers,
+ * per aufs directory, the branch which gave the result of the previous
+ * lookup of a non-directory name, or that the name was not found anywhere.
+ * A hit replays the lookup in that single branch.
+ *
+ * The cache is dropped when the directory is changed through aufs
+ * (i_version), when the branches are changed (sigen), when the lower
+ * directories of the parent change (its dbstart/dbtaildir), at copy-up, and
+ * when hnotify sees a change in a lower directory.  Since the direct branch
+ * access is not detected with udba=reval, the cache is not used then.
+ */
+
+#include "aufs.h"
+
+#define AuLcache_NHASH	64
+#define AuLcache_MAX	1024	/* entries per directory */
+
+struct au_lcache_ent {
+	struct hlist_node	le_hnode;
+	unsigned int		le_hash, le_len;
+	aufs_bindex_t		le_brid;
+	unsigned char		le_positive;
+	unsigned char		le_name[0];
+};
+
+struct au_lcache {
+	spinlock_t		lc_lock;
+	u64			lc_version;
+	unsigned int		lc_sigen;
+	aufs_bindex_t		lc_bstart, lc_btail;
+	unsigned int		lc_nent;
+	unsigned int		lc_gen;	/* bumped at every reset */
+	struct hlist_head	lc_head[AuLcache_NHASH];
+};
+
+static int au_lcache_test(struct super_block *sb)
+{
+	return !au_opt_test(au_mntflags(sb), UDBA_REVAL);
+}
+
+/* caller must hold lc_lock */
+static void au_lcache_do_reset(struct au_lcache *lc)
+{
+	int i;
+	struct au_lcache_ent *ent;
+	struct hlist_node *pos, *n;
+	struct hlist_head *head;
+
+	lc->lc_gen++;
+	if (!lc->lc_nent)
+		return;
+
+	head = lc->lc_head;
+	for (i = 0; i < AuLcache_NHASH; i++, head++) {
+		hlist_for_each_entry_safe(ent, pos, n, head, le_hnode)
+			kfree(ent);
+		INIT_HLIST_HEAD(head);
+	}
+	lc->lc_nent = 0;
+}
+
+/*
+ * drop all entries if they were made for another state of @parent.
+ * caller must hold lc_lock.
+ */
+static void au_lcache_validate(struct au_lcache *lc, struct dentry *parent)
+{
+	unsigned int sigen;
+	aufs_bindex_t bstart, btail;
+	u64 version;
+
+	sigen = au_sigen(parent->d_sb);
+	version = parent->d_inode->i_version;
+	bstart = au_dbstart(parent);
+	btail = au_dbtaildir(parent);
+	if (lc->lc_sigen == sigen
+	    && lc->lc_version == version
+	    && lc->lc_bstart == bstart
+	    && lc->lc_btail == btail)
+		return;
+
+	au_lcache_do_reset(lc);
+	lc->lc_sigen = sigen;
+	lc->lc_version = version;
+	lc->lc_bstart = bstart;
+	lc->lc_btail = btail;
+}
+
+static struct au_lcache_ent *au_lcache_find(struct au_lcache *lc,
+					    const struct qstr *name)
+{
+	struct au_lcache_ent *ent;
+	struct hlist_node *pos;
+	struct hlist_head *head;
+
+	head = lc->lc_head + name->hash % AuLcache_NHASH;
+	hlist_for_each_entry(ent, pos, head, le_hnode)
+		if (ent->le_hash == name->hash
+		    && ent->le_len == name->len
+		    && !memcmp(ent->le_name, name->name, name->len))
+			return ent;
+	return NULL;
+}
+
+static void au_lcache_forget(struct au_lcache *lc, const struct qstr *name)
+{
+	struct au_lcache_ent *ent;
+
+	spin_lock(&lc->lc_lock);
+	ent = au_lcache_find(lc, name);
+	if (ent) {
+		hlist_del(&ent->le_hnode);
+		lc->lc_nent--;
+		kfree(ent);
+	}
+	spin_unlock(&lc->lc_lock);
+}
+
+static struct au_lcache *au_lcache_alloc(struct dentry *parent)
+{
+	int i;
+	struct au_lcache *lc;
+
+	lc = kmalloc(sizeof(*lc), GFP_NOFS);
+	if (unlikely(!lc))
+		return NULL;
+
+	spin_lock_init(&lc->lc_lock);
+	lc->lc_sigen = au_sigen(parent->d_sb);
+	lc->lc_version = parent->d_inode->i_version;
+	lc->lc_bstart = au_dbstart(parent);
+	lc->lc_btail = au_dbtaildir(parent);
+	lc->lc_nent = 0;
+	lc->lc_gen = 0;
+	for (i = 0; i < AuLcache_NHASH; i++)
+		INIT_HLIST_HEAD(lc->lc_head + i);
+	smp_wmb(); /* for au_lcache_reset() */
+	au_ii(parent->d_inode)->ii_lcache = lc;
+	return lc;
+}
+
+/*
+ * returns the number of lower positive dentries (0 or 1) when the result
+ * of the previous lookup is still correct, otherwise -1 and the caller has
+ * to lookup all branches and may pass the result and @gen to
+ * au_lcache_add().
+ * @dentry must be a new one, @parent must be di-locked and its i_mutex held,
+ * which serializes the allocation of the cache.
+ */
+int au_lcache_lkup(struct dentry *dentry, struct dentry *parent,
+		   struct nameidata *nd, unsigned int *gen)
+{
+	int npositive;
+	aufs_bindex_t bindex, brid;
+	struct au_lcache *lc;
+	struct au_lcache_ent *ent;
+	struct dentry *h_parent, *h_dentry;
+	struct inode *h_dir, *h_inode;
+	struct super_block *sb;
+	struct qstr *name;
+
+	*gen = 0;
+	sb = dentry->d_sb;
+	if (!au_lcache_test(sb))
+		return -1;
+	lc = au_ii(parent->d_inode)->ii_lcache;
+	if (!lc) {
+		lc = au_lcache_alloc(parent);
+		if (unlikely(!lc))
+			return -1;
+	}
+
+	npositive = -1;
+	brid = -1;
+	name = &dentry->d_name;
+	spin_lock(&lc->lc_lock);
+	au_lcache_validate(lc, parent);
+	*gen = lc->lc_gen;
+	ent = au_lcache_find(lc, name);
+	if (ent) {
+		npositive = ent->le_positive;
+		brid = ent->le_brid;
+	}
+	spin_unlock(&lc->lc_lock);
+	if (npositive < 0)
+		return -1;
+
+	bindex = au_br_index(sb, brid);
+	if (bindex < au_dbstart(parent) || au_dbtaildir(parent) < bindex)
+		goto out_forget;
+	h_parent = au_h_dptr(parent, bindex);
+	if (!h_parent)
+		goto out_forget;
+	h_dir = h_parent->d_inode;
+	if (!h_dir || !S_ISDIR(h_dir->i_mode))
+		goto out_forget;
+
+	mutex_lock_nested(&h_dir->i_mutex, AuLsc_I_PARENT);
+	h_dentry = au_lkup_one(name, h_parent, au_sbr(sb, bindex), nd);
+	mutex_unlock(&h_dir->i_mutex);
+	if (IS_ERR(h_dentry))
+		return -1; /* let the full lookup report it */
+
+	h_inode = h_dentry->d_inode;
+	if (!h_inode != !npositive
+	    || (h_inode && S_ISDIR(h_inode->i_mode))) {
+		dput(h_dentry);
+		goto out_forget;
+	}
+
+	au_set_dbstart(dentry, bindex);
+	au_set_dbend(dentry, bindex);
+	au_set_h_dptr(dentry, bindex, h_dentry);
+	return npositive;
+
+out_forget:
+	au_lcache_forget(lc, name);
+	return -1;
+}
+
+/*
+ * remember the result of au_lkup_dentry() for @dentry, when it is a
+ * non-directory found in a single branch or a name found nowhere.
+ * nothing is remembered when the cache was reset after au_lcache_lkup()
+ * returned @gen, since the result may be obsolete already.
+ */
+void au_lcache_add(struct dentry *dentry, struct dentry *parent,
+		   int npositive, unsigned int gen)
+{
+	aufs_bindex_t bstart;
+	struct au_lcache *lc;
+	struct au_lcache_ent *ent, *found;
+	struct dentry *h_dentry;
+	struct inode *h_inode;
+	struct super_block *sb;
+	struct qstr *name;
+
+	sb = dentry->d_sb;
+	lc = au_ii(parent->d_inode)->ii_lcache;
+	if (!lc || !au_lcache_test(sb) || au_dbwh(dentry) >= 0)
+		return;
+	bstart = au_dbstart(dentry);
+	if (bstart < 0 || bstart != au_dbend(dentry))
+		return;
+	h_dentry = au_h_dptr(dentry, bstart);
+	if (!h_dentry)
+		return;
+	h_inode = h_dentry->d_inode;
+	if (npositive) {
+		if (npositive != 1 || !h_inode || S_ISDIR(h_inode->i_mode))
+			return;
+	} else if (h_inode)
+		return;
+
+	name = &dentry->d_name;
+	ent = kmalloc(sizeof(*ent) + name->len, GFP_NOFS);
+	if (unlikely(!ent))
+		return;
+	ent->le_hash = name->hash;
+	ent->le_len = name->len;
+	ent->le_brid = au_sbr_id(sb, bstart);
+	ent->le_positive = npositive;
+	memcpy(ent->le_name, name->name, name->len);
+
+	spin_lock(&lc->lc_lock);
+	au_lcache_validate(lc, parent);
+	found = au_lcache_find(lc, name);
+	if (!found && lc->lc_gen == gen && lc->lc_nent < AuLcache_MAX) {
+		hlist_add_head(&ent->le_hnode,
+			       lc->lc_head + name->hash % AuLcache_NHASH);
+		lc->lc_nent++;
+		ent = NULL;
+	}
+	spin_unlock(&lc->lc_lock);
+	kfree(ent);
+}
+
+/* make all the entries of @dir obsolete */
+void au_lcache_reset(struct inode *dir)
+{
+	struct au_lcache *lc;
+
+	lc = au_ii(dir)->ii_lcache;
+	if (lc) {
+		spin_lock(&lc->lc_lock);
+		au_lcache_do_reset(lc);
+		spin_unlock(&lc->lc_lock);
+	}
+}
+
+void au_lcache_free(struct au_lcache *lc)
+{
+	au_lcache_do_reset(lc);
+	kfree(lc);
+}
@@ -838,6 +838,9 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/* No fast commit of the inode for this transaction */
+	tid_t i_fc_ineligible_tid;
 };
 
 /*
@@ -883,6 +886,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_FAST_COMMIT		0x4000000 /* fsync by fast commits */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1105,6 +1109,7 @@ struct ext4_sb_info {
 
 	/* tunables */
 	unsigned long s_stripe;
+	unsigned long s_erase_block;
 	unsigned int s_mb_stream_request;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
@@ -1303,6 +1308,9 @@ EXT4_INODE_BIT_FNS(state, state_flags)
 
 #define EXT4_DEF_INODE_READAHEAD_BLKS	32
 
+/* Size of the journal area for fast commits, in blocks */
+#define EXT4_FC_BLOCKS			64
+
 /*
  * Default mount options
  */
@@ -1520,6 +1528,11 @@ extern int ext4_htree_store_dirent(struct file *dir_file, __u32 hash,
 				    struct ext4_dir_entry_2 *dirent);
 extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode);
+extern int ext4_fc_commit(struct inode *inode, tid_t tid);
+extern void ext4_fc_replay(struct super_block *sb);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
 
@@ -0,0 +1,326 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: fsync of a file without a full journal commit.
+ *
+ * When a regular file whose extents all fit in the inode is fsync'ed and
+ * nothing but the inode itself and its block allocations changed for it
+ * in the running transaction, the raw inode is written to the fast commit
+ * area of the journal, behind a barrier for the file data, instead of
+ * committing the transaction.  That is one block written and one cache
+ * flush, rather than the descriptor, every metadata block the transaction
+ * touched and the commit record.
+ *
+ * Operations whose effects are not described by the inode image (link
+ * count and directory changes, truncate, xattrs, migration, new inodes)
+ * make the inode ineligible until the transaction commits.  After a crash
+ * the records of the transaction which did not reach the log are replayed
+ * at mount time: the inode is copied back into the inode table and the
+ * blocks of its extents are marked in use in the block bitmaps.  Blocks
+ * freed while fast commits are enabled are not reused before the
+ * transaction which freed them commits, so a replayed extent can never
+ * point to blocks the log gives to another file.
+ */
+
+#include <linux/time.h>
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/quotaops.h>
+#include <linux/crc32.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+#define EXT4_FC_MAGIC		0x45344643	/* "E4FC" */
+
+/* Fast commit block: the header, followed by the raw inode */
+struct ext4_fc_head {
+	__le32	fc_magic;
+	__le32	fc_tid;		/* transaction the record belongs to */
+	__le32	fc_ino;
+	__le16	fc_isize;	/* bytes of raw inode which follow */
+	__le16	fc_pad;
+	__le32	fc_crc;		/* crc32 of the header and inode, fc_crc 0 */
+};
+
+/*
+ * Make @inode ineligible for fast commits until the transaction of
+ * @handle has committed.
+ */
+void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode)
+{
+	if (!ext4_handle_valid(handle))
+		return;
+	EXT4_I(inode)->i_fc_ineligible_tid = handle->h_transaction->t_tid;
+}
+
+static int ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) ||
+	    !ext4_should_order_data(inode) ||
+	    EXT4_I(inode)->i_fc_ineligible_tid == tid ||
+	    EXT4_INODE_SIZE(sb) + sizeof(struct ext4_fc_head) >
+	    sb->s_blocksize)
+		return 0;
+#ifdef CONFIG_QUOTA
+	/* Quota usage is not part of the record */
+	if (sb_any_quota_loaded(sb))
+		return 0;
+#endif
+	return 1;
+}
+
+/**
+ * ext4_fc_commit() - Make the metadata of @inode durable with a fast commit
+ * @inode: Inode being fsync'ed, i_mutex held.
+ * @tid: Transaction holding the metadata of @inode.
+ *
+ * Returns 0 if it succeeded, else the caller must commit @tid.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	struct address_space *mapping = inode->i_mapping;
+	struct ext4_fc_head *head;
+	struct buffer_head *bh;
+	struct ext4_iloc iloc;
+	int isize = EXT4_INODE_SIZE(sb);
+	tid_t ctid = 0;
+	int err;
+
+	if (!ext4_fc_eligible(inode, tid))
+		return -EAGAIN;
+
+	/*
+	 * The record covers all the blocks of the file, not just the range
+	 * being synced, and there is no ordered data list to wait on: the
+	 * data of every block the inode points to must be on disk first.
+	 */
+	err = filemap_write_and_wait(mapping);
+	if (err)
+		return err;
+
+	/* Fast commits only go in while no transaction is committing */
+	spin_lock(&journal->j_state_lock);
+	if (journal->j_committing_transaction)
+		ctid = journal->j_committing_transaction->t_tid;
+	spin_unlock(&journal->j_state_lock);
+	if (ctid)
+		jbd2_log_wait_commit(journal, ctid);
+
+	err = jbd2_fc_begin_commit(journal, tid);
+	if (err)
+		return err;
+
+	err = ext4_get_inode_loc(inode, &iloc);
+	if (err)
+		goto out;
+	err = jbd2_fc_get_buf(journal, &bh);
+	if (err) {
+		brelse(iloc.bh);
+		goto out;
+	}
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, bh->b_size);
+	head = (struct ext4_fc_head *)bh->b_data;
+	down_read(&EXT4_I(inode)->i_data_sem);
+	if (ext_depth(inode) != 0)
+		err = -EAGAIN;
+	else
+		memcpy(head + 1, ext4_raw_inode(&iloc), isize);
+	/*
+	 * Writeback of mmap'ed pages may have allocated blocks since, with
+	 * their data still in flight.  A page stays tagged dirty or under
+	 * writeback from before its blocks are allocated until its data
+	 * is written.
+	 */
+	if (mapping_tagged(mapping, PAGECACHE_TAG_DIRTY) ||
+	    mapping_tagged(mapping, PAGECACHE_TAG_WRITEBACK))
+		err = -EAGAIN;
+	up_read(&EXT4_I(inode)->i_data_sem);
+	head->fc_magic = cpu_to_le32(EXT4_FC_MAGIC);
+	head->fc_tid = cpu_to_le32(tid);
+	head->fc_ino = cpu_to_le32(inode->i_ino);
+	head->fc_isize = cpu_to_le16(isize);
+	head->fc_crc = cpu_to_le32(crc32_be(~0, bh->b_data,
+					    sizeof(*head) + isize));
+	unlock_buffer(bh);
+	brelse(iloc.bh);
+
+	if (!err) {
+		/*
+		 * With an external journal the barrier of the record does
+		 * not cover the file data.
+		 */
+		if (journal->j_fs_dev != journal->j_dev &&
+		    (journal->j_flags & JBD2_BARRIER))
+			blkdev_issue_flush(sb->s_bdev, GFP_KERNEL, NULL,
+					   BLKDEV_IFL_WAIT);
+		err = jbd2_fc_write_buf(journal, bh);
+	}
+	brelse(bh);
+out:
+	jbd2_fc_end_commit(journal, err);
+	return err;
+}
+
+/*
+ * Mark blocks @start to @start + @len - 1, all in @group, in use.
+ * Returns the number of blocks which were free.
+ */
+static int ext4_fc_replay_range(struct super_block *sb, ext4_group_t group,
+				ext4_grpblk_t start, int len)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *gd_bh;
+	struct buffer_head *bitmap_bh;
+	int i, count = 0;
+
+	gdp = ext4_get_group_desc(sb, group, &gd_bh);
+	if (!gdp)
+		return -EIO;
+	bitmap_bh = ext4_read_block_bitmap(sb, group);
+	if (!bitmap_bh)
+		return -EIO;
+
+	ext4_lock_group(sb, group);
+	if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+		gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+		ext4_free_blks_set(sb, gdp,
+				   ext4_free_blocks_after_init(sb, group, gdp));
+	}
+	for (i = start; i < start + len; i++)
+		if (!ext4_set_bit(i, bitmap_bh->b_data))
+			count++;
+	ext4_free_blks_set(sb, gdp, ext4_free_blks_count(sb, gdp) - count);
+	gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+	ext4_unlock_group(sb, group);
+
+	if (sbi->s_log_groups_per_flex)
+		atomic_sub(count, &sbi->s_flex_groups[
+				ext4_flex_group(sbi, group)].free_blocks);
+
+	mark_buffer_dirty(bitmap_bh);
+	sync_dirty_buffer(bitmap_bh);
+	brelse(bitmap_bh);
+	mark_buffer_dirty(gd_bh);
+	sync_dirty_buffer(gd_bh);
+	return count;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				struct ext4_inode *raw, int isize)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	ext4_group_t group;
+	ext4_grpblk_t offset;
+	ext4_fsblk_t block, end;
+	int inodes_per_block, inode_offset, len, n, i;
+
+	if (!ext4_valid_inum(sb, ino) || isize != EXT4_INODE_SIZE(sb) ||
+	    !(le32_to_cpu(raw->i_flags) & EXT4_EXTENTS_FL))
+		return -EIO;
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth != 0 ||
+	    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max) ||
+	    le16_to_cpu(eh->eh_max) > 4)
+		return -EIO;
+
+	/* Blocks first, the inode must never point to free blocks */
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		block = ext_pblock(ex);
+		len = ext4_ext_get_actual_len(ex);
+		end = block + len;
+		if (block < le32_to_cpu(sbi->s_es->s_first_data_block) ||
+		    end > ext4_blocks_count(sbi->s_es) || end < block)
+			return -EIO;
+		while (block < end) {
+			ext4_get_group_no_and_offset(sb, block, &group, &offset);
+			n = min_t(ext4_fsblk_t, end - block,
+				  EXT4_BLOCKS_PER_GROUP(sb) - offset);
+			if (ext4_fc_replay_range(sb, group, offset, n) < 0)
+				return -EIO;
+			block += n;
+		}
+	}
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+	inodes_per_block = EXT4_BLOCK_SIZE(sb) / EXT4_INODE_SIZE(sb);
+	inode_offset = (ino - 1) % EXT4_INODES_PER_GROUP(sb);
+	block = ext4_inode_table(sb, gdp) + inode_offset / inodes_per_block;
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	lock_buffer(bh);
+	memcpy(bh->b_data + (inode_offset % inodes_per_block) * isize,
+	       raw, isize);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	sync_dirty_buffer(bh);
+	brelse(bh);
+	return 0;
+}
+
+/*
+ * Replay the fast commits left by jbd2 recovery, before the free block
+ * counters are computed from the group descriptors.  Records are read in
+ * order up to the first one which is not a valid record of the
+ * transaction being replayed.
+ */
+void ext4_fc_replay(struct super_block *sb)
+{
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	struct ext4_fc_head *head;
+	struct buffer_head *bh;
+	unsigned int index, isize, replayed = 0;
+	u32 crc;
+
+	if (!(journal->j_flags & JBD2_FC_REPLAY))
+		return;
+
+	for (index = 0; (bh = jbd2_fc_read_buf(journal, index)); index++) {
+		head = (struct ext4_fc_head *)bh->b_data;
+		isize = le16_to_cpu(head->fc_isize);
+		if (le32_to_cpu(head->fc_magic) != EXT4_FC_MAGIC ||
+		    le32_to_cpu(head->fc_tid) != journal->j_fc_replay_tid ||
+		    isize + sizeof(*head) > bh->b_size) {
+			brelse(bh);
+			break;
+		}
+		crc = le32_to_cpu(head->fc_crc);
+		head->fc_crc = 0;
+		if (crc32_be(~0, bh->b_data, sizeof(*head) + isize) != crc) {
+			brelse(bh);
+			break;
+		}
+		if (ext4_fc_replay_inode(sb, le32_to_cpu(head->fc_ino),
+					 (struct ext4_inode *)(head + 1), isize))
+			ext4_msg(sb, KERN_WARNING, "fast commit replay of "
+				 "inode %u failed", le32_to_cpu(head->fc_ino));
+		else
+			replayed++;
+		brelse(bh);
+	}
+
+	if (replayed)
+		ext4_msg(sb, KERN_INFO, "replayed %u fast commits", replayed);
+	spin_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FC_REPLAY;
+	spin_unlock(&journal->j_state_lock);
+}
@@ -1014,6 +1014,8 @@ got:
 
 	ei->i_state_flags = 0;
 	ext4_set_inode_state(inode, EXT4_STATE_NEW);
+	/* Neither the inode bitmap nor the directory entry are replayed */
+	ext4_fc_mark_ineligible(handle, inode);
 
 	ei->i_extra_isize = EXT4_SB(sb)->s_want_extra_isize;
 
@@ -131,7 +131,9 @@
  * /sys/fs/ext4/<partition/mb_group_prealloc. The value is represented in
  * terms of number of blocks. If we have mounted the file system with -O
  * stripe=<value> option the group prealloc request is normalized to the
- * stripe value (sbi->s_stripe)
+ * stripe value (sbi->s_stripe). With -o erase_block=<value> it is rounded
+ * up to whole erase blocks (sbi->s_erase_block) of the flash device, and so
+ * are the inode preallocations, both in size and logical offset.
  *
  * The regular allocator(using the buddy cache) supports few tunables.
  *
@@ -144,7 +146,10 @@
  * value of s_mb_order2_reqs can be tuned via
  * /sys/fs/ext4/<partition>/mb_order2_req.  If the request len is equal to
  * stripe size (sbi->s_stripe), we try to search for contiguous block in
- * stripe size. This should result in better allocation on RAID setups. If
+ * stripe size. This should result in better allocation on RAID setups.
+ * Likewise requests of whole erase blocks are placed at erase block
+ * boundaries, so that the FTL of SD cards and eMMC sees whole erase blocks
+ * written instead of partial ones needing read-modify-write. If
  * not, we search in the specific group using bitmap for best extents. The
  * tunable min_to_scan and max_to_scan control the behaviour here.
  * min_to_scan indicate how long the mballoc __must__ look for a best
@@ -1663,14 +1668,30 @@ int ext4_mb_try_best_found(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * returns the alignment the goal extent should be allocated with:
+ * the stripe for stripe-size requests, an erase block for requests of
+ * whole erase blocks, otherwise 0
+ */
+static unsigned long ext4_mb_goal_align(struct ext4_allocation_context *ac)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+
+	if (sbi->s_stripe && ac->ac_g_ex.fe_len == sbi->s_stripe)
+		return sbi->s_stripe;
+	if (sbi->s_erase_block && ac->ac_g_ex.fe_len % sbi->s_erase_block == 0)
+		return sbi->s_erase_block;
+	return 0;
+}
+
 static noinline_for_stack
 int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 				struct ext4_buddy *e4b)
 {
 	ext4_group_t group = ac->ac_g_ex.fe_group;
+	unsigned long align = ext4_mb_goal_align(ac);
 	int max;
 	int err;
-	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
 	struct ext4_free_extent ex;
 
 	if (!(ac->ac_flags & EXT4_MB_HINT_TRY_GOAL))
@@ -1684,13 +1705,13 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len && align) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, align) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1822,43 +1843,44 @@ void ext4_mb_complex_scan_group(struct ext4_allocation_context *ac,
 }
 
 /*
- * This is a special case for storages like raid5
+ * This is a special case for storages like raid5 and flash
  * we try to find stripe-aligned chunks for stripe-size requests
+ * and erase block aligned chunks for multiples of the erase block
  * XXX should do so at least for multiples of stripe size as well
  */
 static noinline_for_stack
 void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
-				 struct ext4_buddy *e4b)
+				 struct ext4_buddy *e4b, unsigned long align)
 {
 	struct super_block *sb = ac->ac_sb;
-	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
 	ext4_fsblk_t first_group_block;
 	ext4_fsblk_t a;
 	ext4_grpblk_t i;
+	int len = ac->ac_g_ex.fe_len;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(align == 0);
 
-	/* find first stripe-aligned block in group */
+	/* find first aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + align - 1;
+	do_div(a, align);
+	i = (a * align) - first_group_block;
 
-	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
+	while (i + len <= EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, len, &ex);
+			if (max >= len) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += align;
 	}
 }
 
@@ -2096,9 +2118,9 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 &&
-					ac->ac_g_ex.fe_len == sbi->s_stripe)
-				ext4_mb_scan_aligned(ac, &e4b);
+			else if (cr == 1 && ext4_mb_goal_align(ac))
+				ext4_mb_scan_aligned(ac, &e4b,
+						     ext4_mb_goal_align(ac));
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
 
@@ -2823,7 +2845,8 @@ out_err:
  * here we normalize request for locality group
  * Group request are normalized to s_strip size if we set the same via mount
  * option. If not we set it to s_mb_group_prealloc which can be configured via
- * /sys/fs/ext4/<partition>/mb_group_prealloc
+ * /sys/fs/ext4/<partition>/mb_group_prealloc, rounded up to whole erase
+ * blocks if the erase_block mount option is given
  *
  * XXX: should we try to preallocate more than the group has now?
  */
@@ -2835,6 +2858,9 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 	BUG_ON(lg == NULL);
 	if (EXT4_SB(sb)->s_stripe)
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_stripe;
+	else if (EXT4_SB(sb)->s_erase_block)
+		ac->ac_g_ex.fe_len = roundup(EXT4_SB(sb)->s_mb_group_prealloc,
+					     EXT4_SB(sb)->s_erase_block);
 	else
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
@@ -2927,6 +2953,20 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	orig_size = size = size >> bsbits;
 	orig_start = start = start_off >> bsbits;
 
+	/* cover whole erase blocks, so that the file gets them alone */
+	if (EXT4_SB(ac->ac_sb)->s_erase_block) {
+		ext4_lblk_t eb = EXT4_SB(ac->ac_sb)->s_erase_block;
+
+		/* in 32 bit block units, size is a loff_t */
+		end = roundup(start + (ext4_lblk_t)size, eb);
+		start -= start % eb;
+		if (end - start <= EXT4_BLOCKS_PER_GROUP(ac->ac_sb)) {
+			orig_size = size = end - start;
+			orig_start = start;
+		} else
+			start = orig_start;
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -4625,11 +4665,15 @@ do_more:
 	if (err)
 		goto error_return;
 
-	if ((flags & EXT4_FREE_BLOCKS_METADATA) && ext4_handle_valid(handle)) {
+	if (((flags & EXT4_FREE_BLOCKS_METADATA) ||
+	     (sbi->s_journal && sbi->s_journal->j_fc_last)) &&
+	    ext4_handle_valid(handle)) {
 		struct ext4_free_data *new_entry;
 		/*
 		 * blocks being freed are metadata. these blocks shouldn't
-		 * be used until this transaction is committed
+		 * be used until this transaction is committed.  With fast
+		 * commits data blocks neither, a replayed inode could get
+		 * them back.
 		 */
 		new_entry  = kmem_cache_alloc(ext4_free_ext_cachep, GFP_NOFS);
 		new_entry->start_blk = bit;
@@ -766,6 +766,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->cur_aio_dio = NULL;
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_fc_ineligible_tid = 0;
 
 	return &ei->vfs_inode;
 }
@@ -956,6 +957,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (sbi->s_erase_block)
+		seq_printf(seq, ",erase_block=%lu", sbi->s_erase_block);
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -980,6 +983,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt(sb, FAST_COMMIT))
+		seq_puts(seq, ",fast_commit");
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1156,11 +1162,11 @@ enum {
 	Opt_jqfmt_vfsold, Opt_jqfmt_vfsv0, Opt_jqfmt_vfsv1, Opt_quota,
 	Opt_noquota, Opt_ignore, Opt_barrier, Opt_nobarrier, Opt_err,
 	Opt_resize, Opt_usrquota, Opt_grpquota, Opt_i_version,
-	Opt_stripe, Opt_delalloc, Opt_nodelalloc,
+	Opt_stripe, Opt_erase_block, Opt_delalloc, Opt_nodelalloc,
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
-	Opt_discard, Opt_nodiscard,
+	Opt_discard, Opt_nodiscard, Opt_fast_commit, Opt_nofast_commit,
 };
 
 static const match_table_t tokens = {
@@ -1217,6 +1223,7 @@ static const match_table_t tokens = {
 	{Opt_nobarrier, "nobarrier"},
 	{Opt_i_version, "i_version"},
 	{Opt_stripe, "stripe=%u"},
+	{Opt_erase_block, "erase_block=%u"},
 	{Opt_resize, "resize"},
 	{Opt_delalloc, "delalloc"},
 	{Opt_nodelalloc, "nodelalloc"},
@@ -1231,6 +1238,8 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_fast_commit, "fast_commit"},
+	{Opt_nofast_commit, "nofast_commit"},
 	{Opt_err, NULL},
 };
 
@@ -1643,6 +1652,20 @@ set_qf_format:
 				return 0;
 			sbi->s_stripe = option;
 			break;
+		case Opt_erase_block:
+			if (match_int(&args[0], &option))
+				return 0;
+			if (option < 0)
+				return 0;
+			/* s_blocks_per_group is only known here on remount */
+			if (sbi->s_blocks_per_group &&
+			    option > sbi->s_blocks_per_group) {
+				ext4_msg(sb, KERN_ERR,
+					 "erase_block larger than a block group");
+				return 0;
+			}
+			sbi->s_erase_block = option;
+			break;
 		case Opt_delalloc:
 			set_opt(sbi->s_mount_opt, DELALLOC);
 			break;
@@ -1693,6 +1716,12 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sbi->s_mount_opt, DISCARD);
 			break;
+		case Opt_fast_commit:
+			set_opt(sbi->s_mount_opt, FAST_COMMIT);
+			break;
+		case Opt_nofast_commit:
+			clear_opt(sbi->s_mount_opt, FAST_COMMIT);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
@@ -2818,6 +2847,11 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	if (sbi->s_erase_block > sbi->s_blocks_per_group) {
+		ext4_msg(sb, KERN_WARNING,
+			 "erase_block larger than a block group, ignored");
+		sbi->s_erase_block = 0;
+	}
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -2915,6 +2949,18 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 	set_task_ioprio(sbi->s_journal->j_task, journal_ioprio);
 
+	ext4_fc_replay(sb);
+	if (!(sb->s_flags & MS_RDONLY)) {
+		err = jbd2_fc_init(sbi->s_journal, test_opt(sb, FAST_COMMIT) ?
+				   EXT4_FC_BLOCKS : 0);
+		if (err) {
+			ext4_msg(sb, KERN_WARNING, "can't %s the fast commit "
+				 "area (%d)", test_opt(sb, FAST_COMMIT) ?
+				 "reserve" : "release", err);
+			clear_opt(sbi->s_mount_opt, FAST_COMMIT);
+		}
+	}
+
 	/*
 	 * The journal may have updated the bg summary counts, so we
 	 * need to update the global counters.
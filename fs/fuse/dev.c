@@ -34,34 +34,58 @@ static struct fuse_conn *fuse_get_conn(struct file *file)
 	return file->private_data;
 }
 
-static void fuse_request_init(struct fuse_req *req)
+/* A NULL page vector means the inline one */
+static void fuse_request_init(struct fuse_req *req, struct page **pages,
+			      unsigned npages)
 {
 	memset(req, 0, sizeof(*req));
 	INIT_LIST_HEAD(&req->list);
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	if (pages) {
+		req->pages = pages;
+		req->max_pages = npages;
+	} else {
+		req->pages = req->inline_pages;
+		req->max_pages = FUSE_MAX_PAGES_PER_REQ;
+	}
 }
 
-struct fuse_req *fuse_request_alloc(void)
+static struct fuse_req *__fuse_request_alloc(unsigned npages, gfp_t flags)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_KERNEL);
-	if (req)
-		fuse_request_init(req);
+	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, flags);
+	struct page **pages = NULL;
+
+	if (!req)
+		return NULL;
+
+	if (npages > FUSE_MAX_PAGES_PER_REQ) {
+		pages = kmalloc(sizeof(struct page *) * npages, flags);
+		if (!pages) {
+			kmem_cache_free(fuse_req_cachep, req);
+			return NULL;
+		}
+	}
+	fuse_request_init(req, pages, npages);
 	return req;
 }
+
+struct fuse_req *fuse_request_alloc(void)
+{
+	return __fuse_request_alloc(0, GFP_KERNEL);
+}
 EXPORT_SYMBOL_GPL(fuse_request_alloc);
 
 struct fuse_req *fuse_request_alloc_nofs(void)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_NOFS);
-	if (req)
-		fuse_request_init(req);
-	return req;
+	return __fuse_request_alloc(0, GFP_NOFS);
 }
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -97,7 +121,7 @@ static void fuse_req_init_context(struct fuse_req *req)
 	req->in.h.pid = current->pid;
 }
 
-struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages)
 {
 	struct fuse_req *req;
 	sigset_t oldset;
@@ -116,7 +140,7 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	if (!fc->connected)
 		goto out;
 
-	req = fuse_request_alloc();
+	req = __fuse_request_alloc(npages, GFP_KERNEL);
 	err = -ENOMEM;
 	if (!req)
 		goto out;
@@ -129,6 +153,12 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	atomic_dec(&fc->num_waiting);
 	return ERR_PTR(err);
 }
+EXPORT_SYMBOL_GPL(fuse_get_req_pages);
+
+struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+{
+	return fuse_get_req_pages(fc, 0);
+}
 EXPORT_SYMBOL_GPL(fuse_get_req);
 
 /*
@@ -166,7 +196,7 @@ static void put_reserved_req(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_file *ff = file->private_data;
 
 	spin_lock(&fc->lock);
-	fuse_request_init(req);
+	fuse_request_init(req, NULL, 0);
 	BUG_ON(ff->reserved_req);
 	ff->reserved_req = req;
 	wake_up_all(&fc->reserved_req_waitq);
@@ -208,6 +238,9 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		if (req->passthrough_filp)
+			fput(req->passthrough_filp);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -551,6 +584,19 @@ static void fuse_copy_finish(struct fuse_copy_state *cs)
 	}
 }
 
+/*
+ * Give back the unused part of the userspace page copied last, so that
+ * the next request or reply of a batch starts right where this one
+ * ended.  Only for userspace buffers, not for pipe buffers.
+ */
+static void fuse_copy_rewind(struct fuse_copy_state *cs)
+{
+	cs->addr -= cs->len;
+	cs->seglen += cs->len;
+	cs->len = 0;
+	cs->req = NULL;
+}
+
 /*
  * Get another pagefull of userspace buffer, and map it to kernel
  * address space, and lock request
@@ -945,58 +991,23 @@ __releases(&fc->lock)
 }
 
 /*
- * Read a single request into the userspace filesystem's buffer.  This
- * function waits until a request is available, then removes it from
- * the pending list and copies request data to userspace buffer.  If
- * no reply is needed (FORGET) or request has been aborted or there
+ * Copy a request taken off the pending list to the userspace buffer.
+ * If no reply is needed (FORGET) or request has been aborted or there
  * was an error during the copying then it's finished by calling
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
+ *
+ * Called with fc->lock held, releases it
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
-				struct fuse_copy_state *cs, size_t nbytes)
+static ssize_t fuse_read_request(struct fuse_conn *fc,
+				 struct fuse_copy_state *cs,
+				 struct fuse_req *req)
+__releases(&fc->lock)
 {
+	struct fuse_in *in = &req->in;
+	unsigned reqsize = in->h.len;
 	int err;
-	struct fuse_req *req;
-	struct fuse_in *in;
-	unsigned reqsize;
 
- restart:
-	spin_lock(&fc->lock);
-	err = -EAGAIN;
-	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
-	    !request_pending(fc))
-		goto err_unlock;
-
-	request_wait(fc);
-	err = -ENODEV;
-	if (!fc->connected)
-		goto err_unlock;
-	err = -ERESTARTSYS;
-	if (!request_pending(fc))
-		goto err_unlock;
-
-	if (!list_empty(&fc->interrupts)) {
-		req = list_entry(fc->interrupts.next, struct fuse_req,
-				 intr_entry);
-		return fuse_read_interrupt(fc, cs, nbytes, req);
-	}
-
-	req = list_entry(fc->pending.next, struct fuse_req, list);
-	req->state = FUSE_REQ_READING;
-	list_move(&req->list, &fc->io);
-
-	in = &req->in;
-	reqsize = in->h.len;
-	/* If request is too large, reply with an error and restart the read */
-	if (nbytes < reqsize) {
-		req->out.h.error = -EIO;
-		/* SETXATTR is special, since it may contain too large data */
-		if (in->h.opcode == FUSE_SETXATTR)
-			req->out.h.error = -E2BIG;
-		request_end(fc, req);
-		goto restart;
-	}
 	spin_unlock(&fc->lock);
 	cs->req = req;
 	err = fuse_copy_one(cs, &in->h, sizeof(in->h));
@@ -1025,6 +1036,95 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		spin_unlock(&fc->lock);
 	}
 	return reqsize;
+}
+
+/*
+ * Read requests into the userspace filesystem's buffer.  This function
+ * waits until a request is available and copies it to the buffer.
+ *
+ * With FUSE_BATCH, requests which are already pending are then copied
+ * right after it, for as long as they fit into the buffer.  Requests
+ * are never split, so the filesystem finds them by their in.h.len.
+ * Splice reads still return a single request.
+ */
+static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+				struct fuse_copy_state *cs, size_t nbytes)
+{
+	ssize_t err;
+	size_t total;
+	struct fuse_req *req;
+	struct fuse_in *in;
+
+ restart:
+	spin_lock(&fc->lock);
+	err = -EAGAIN;
+	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
+	    !request_pending(fc))
+		goto err_unlock;
+
+	request_wait(fc);
+	err = -ENODEV;
+	if (!fc->connected)
+		goto err_unlock;
+	err = -ERESTARTSYS;
+	if (!request_pending(fc))
+		goto err_unlock;
+
+	if (!list_empty(&fc->interrupts)) {
+		req = list_entry(fc->interrupts.next, struct fuse_req,
+				 intr_entry);
+		err = fuse_read_interrupt(fc, cs, nbytes, req);
+	} else {
+		req = list_entry(fc->pending.next, struct fuse_req, list);
+		req->state = FUSE_REQ_READING;
+		list_move(&req->list, &fc->io);
+
+		in = &req->in;
+		/*
+		 * If request is too large, reply with an error and restart
+		 * the read
+		 */
+		if (nbytes < in->h.len) {
+			req->out.h.error = -EIO;
+			/* SETXATTR is special, it may contain too large data */
+			if (in->h.opcode == FUSE_SETXATTR)
+				req->out.h.error = -E2BIG;
+			request_end(fc, req);
+			goto restart;
+		}
+		err = fuse_read_request(fc, cs, req);
+	}
+	if (err < 0 || !fc->batch || cs->pipebufs)
+		return err;
+
+	for (total = err; ; total += err) {
+		fuse_copy_rewind(cs);
+		spin_lock(&fc->lock);
+		if (!fc->connected || !request_pending(fc))
+			break;
+
+		if (!list_empty(&fc->interrupts)) {
+			if (nbytes - total < sizeof(struct fuse_in_header) +
+			    sizeof(struct fuse_interrupt_in))
+				break;
+			req = list_entry(fc->interrupts.next, struct fuse_req,
+					 intr_entry);
+			err = fuse_read_interrupt(fc, cs, nbytes - total, req);
+		} else {
+			req = list_entry(fc->pending.next, struct fuse_req,
+					 list);
+			if (nbytes - total < req->in.h.len)
+				break;
+			req->state = FUSE_REQ_READING;
+			list_move(&req->list, &fc->io);
+			err = fuse_read_request(fc, cs, req);
+		}
+		/* The failed request has been finished already */
+		if (err < 0)
+			return total;
+	}
+	spin_unlock(&fc->lock);
+	return total;
 
  err_unlock:
 	spin_unlock(&fc->lock);
@@ -1291,11 +1391,14 @@ static int copy_out_args(struct fuse_copy_state *cs, struct fuse_out *out,
  * Write a single reply to a request.  First the header is copied from
  * the write buffer.  The request is then searched on the processing
  * list by the unique ID found in the header.  If found, then remove
- * it from the list and copy the rest of the buffer to the request.
+ * it from the list and copy the rest of the reply to the request.
  * The request is finished by calling request_end()
+ *
+ * Returns the length of the reply, which is less than nbytes if more
+ * replies of a batch follow.
  */
-static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
-				 struct fuse_copy_state *cs, size_t nbytes)
+static ssize_t fuse_dev_write_one(struct fuse_conn *fc,
+				  struct fuse_copy_state *cs, size_t nbytes)
 {
 	int err;
 	struct fuse_req *req;
@@ -1309,8 +1412,12 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 		goto err_finish;
 
 	err = -EINVAL;
-	if (oh.len != nbytes)
-		goto err_finish;
+	if (oh.len != nbytes) {
+		if (!fc->batch || cs->pipebufs ||
+		    oh.len < sizeof(struct fuse_out_header) || oh.len > nbytes)
+			goto err_finish;
+		nbytes = oh.len;
+	}
 
 	/*
 	 * Zero oh.unique indicates unsolicited notification message
@@ -1369,6 +1476,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	if (!err && !oh.error && fc->passthrough)
+		fuse_passthrough_setup(fc, req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -1387,6 +1497,28 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	return err;
 }
 
+/*
+ * With FUSE_BATCH a write may contain several replies back to back.
+ * They are processed in order up to the first one which fails: if that
+ * is not the first one, the length of the replies before it is returned.
+ */
+static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
+				 struct fuse_copy_state *cs, size_t nbytes)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	for (;;) {
+		ret = fuse_dev_write_one(fc, cs, nbytes - done);
+		if (ret < 0)
+			return done ? done : ret;
+		done += ret;
+		if (done == nbytes)
+			return done;
+		fuse_copy_rewind(cs);
+	}
+}
+
 static ssize_t fuse_dev_write(struct kiocb *iocb, const struct iovec *iov,
 			      unsigned long nr_segs, loff_t pos)
 {
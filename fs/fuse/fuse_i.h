@@ -23,9 +23,12 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
+/** Default max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** Maximum of max_pages received in init_out */
+#define FUSE_MAX_MAX_PAGES 256
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -35,6 +38,9 @@
 /** Number of dentries for each connection in the control filesystem */
 #define FUSE_CTL_NUM_DENTRIES 5
 
+/** Magic number of fuse and fuseblk superblocks */
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
     permission checking is done in the kernel */
@@ -121,6 +127,9 @@ struct fuse_file {
 	/** FOPEN_* flags returned by open */
 	u32 open_flags;
 
+	/** File of the daemon which read, write and mmap are passed to */
+	struct file *passthrough_filp;
+
 	/** Entry on inode's write_files list */
 	struct list_head write_entry;
 
@@ -280,7 +289,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** inline page vector, used unless more pages are needed */
+	struct page *inline_pages[FUSE_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -302,6 +317,9 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Passthrough file returned in the reply to OPEN or CREATE */
+	struct file *passthrough_filp;
 };
 
 /**
@@ -336,6 +354,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages in a read or write request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -460,6 +481,12 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** May open files in passthrough mode */
+	unsigned passthrough:1;
+
+	/** Several requests per read and replies per write on the device */
+	unsigned batch:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -642,6 +669,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for npages pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -752,4 +784,17 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
 
+void fuse_write_update_size(struct inode *inode, loff_t pos);
+
+/**
+ * Passthrough of read, write and mmap to a file of the daemon
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+bool fuse_passthrough_usable(struct file *file, struct file *backing);
+ssize_t fuse_passthrough_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos);
+ssize_t fuse_passthrough_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
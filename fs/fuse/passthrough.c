@@ -0,0 +1,145 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough mode: when the filesystem daemon only forwards I/O to a
+ * file of its own, it may answer OPEN or CREATE with FOPEN_PASSTHROUGH
+ * and the descriptor of that file in passthrough_fd.  Reads, writes and
+ * mmaps of the FUSE file then go directly to the daemon's file, with the
+ * daemon's credentials, and never reach userspace.  All other operations,
+ * including getattr, fsync and release, still go to the daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/cred.h>
+#include <linux/pagemap.h>
+
+/*
+ * Called from the daemon's write() on the device, so that passthrough_fd
+ * is looked up in the daemon's file table.  If the file can't be used
+ * the open simply goes on without passthrough.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *backing;
+	struct inode *inode;
+
+	if (req->in.h.opcode == FUSE_OPEN && req->out.numargs == 1)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE && req->out.numargs == 2)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	backing = fget(outarg->passthrough_fd);
+	if (!backing)
+		return;
+
+	inode = backing->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) || !backing->f_op ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC) {
+		fput(backing);
+		return;
+	}
+
+	req->passthrough_filp = backing;
+}
+
+/*
+ * Check that the daemon's file was opened with at least the access
+ * mode of the FUSE file.
+ */
+bool fuse_passthrough_usable(struct file *file, struct file *backing)
+{
+	if ((file->f_mode & FMODE_READ) && !(backing->f_mode & FMODE_READ))
+		return false;
+	if ((file->f_mode & FMODE_WRITE) && !(backing->f_mode & FMODE_WRITE))
+		return false;
+	return true;
+}
+
+ssize_t fuse_passthrough_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough_filp;
+	const struct cred *old_cred;
+	ssize_t res;
+
+	old_cred = override_creds(backing->f_cred);
+	res = vfs_read(backing, buf, count, ppos);
+	revert_creds(old_cred);
+
+	return res;
+}
+
+ssize_t fuse_passthrough_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough_filp;
+	struct inode *inode = file->f_path.dentry->d_inode;
+	const struct cred *old_cred;
+	loff_t pos;
+	ssize_t res;
+
+	mutex_lock(&inode->i_mutex);
+
+	if (file->f_flags & O_APPEND)
+		*ppos = i_size_read(backing->f_path.dentry->d_inode);
+	pos = *ppos;
+
+	old_cred = override_creds(backing->f_cred);
+	res = vfs_write(backing, buf, count, ppos);
+	revert_creds(old_cred);
+
+	if (res > 0) {
+		fuse_write_update_size(inode, *ppos);
+		/* Don't leave stale pages for openers without passthrough */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					pos >> PAGE_CACHE_SHIFT,
+					(*ppos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+
+	mutex_unlock(&inode->i_mutex);
+
+	return res;
+}
+
+/*
+ * Map the daemon's file instead of the FUSE file, so that page faults
+ * are served from its page cache without involving the daemon.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough_filp;
+	int err;
+
+	if (!backing->f_op->mmap)
+		return -ENODEV;
+
+	err = backing->f_op->mmap(backing, vma);
+	if (err)
+		return err;
+
+	get_file(backing);
+	vma->vm_file = backing;
+	fput(file);
+
+	return 0;
+}
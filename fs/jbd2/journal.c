@@ -92,10 +92,17 @@ EXPORT_SYMBOL(jbd2_journal_file_inode);
 EXPORT_SYMBOL(jbd2_journal_init_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_release_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_begin_ordered_truncate);
+EXPORT_SYMBOL(jbd2_fc_init);
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+EXPORT_SYMBOL(jbd2_fc_write_buf);
+EXPORT_SYMBOL(jbd2_fc_read_buf);
 
 static int journal_convert_superblock_v1(journal_t *, journal_superblock_t *);
 static void __journal_abort_soft (journal_t *journal, int errno);
 static int jbd2_journal_create_slab(size_t slab_size);
+static void journal_fc_setup(journal_t *journal);
 
 /*
  * Helper function used to manage commit timeouts
@@ -686,6 +693,247 @@ struct journal_head *jbd2_journal_get_descriptor_buffer(journal_t *journal)
 	return jbd2_journal_add_journal_head(bh);
 }
 
+/*
+ * Fast commits.
+ *
+ * A fast commit lets the filesystem make an fsync durable without
+ * committing the whole running transaction: it writes its own records for
+ * the running transaction into a small area after the log, reserved by
+ * s_num_fc_blks, and replays them itself after recovery.  The area is
+ * reused from its start by each transaction, so fast commits are only
+ * allowed while no transaction is committing, and the commit of a
+ * transaction waits until its fast commits are done.
+ */
+
+static void journal_fc_setup(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long nblocks = be32_to_cpu(sb->s_num_fc_blks);
+
+	journal->j_fc_first = journal->j_fc_last = journal->j_fc_off = 0;
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT) ||
+	    !nblocks)
+		return;
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + nblocks >
+	    journal->j_last) {
+		printk(KERN_WARNING "JBD2: %s: fast commit area of %lu "
+		       "blocks too large, ignored\n", journal->j_devname,
+		       nblocks);
+		return;
+	}
+	journal->j_fc_last = journal->j_last;
+	journal->j_last -= nblocks;
+	journal->j_fc_first = journal->j_last;
+}
+
+/**
+ * int jbd2_fc_init() - Reserve or release the fast commit area.
+ * @journal: Journal to act on.
+ * @nblocks: Size of the area in blocks, 0 to release it.
+ *
+ * The log must be empty, as it is right after jbd2_journal_load().
+ * Returns -EBUSY if it is not.
+ */
+int jbd2_fc_init(journal_t *journal, unsigned int nblocks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long last;
+
+	if (nblocks == be32_to_cpu(sb->s_num_fc_blks) &&
+	    (nblocks != 0) == JBD2_HAS_INCOMPAT_FEATURE(journal,
+				JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+
+	spin_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_checkpoint_transactions ||
+	    journal->j_head != journal->j_tail) {
+		spin_unlock(&journal->j_state_lock);
+		return -EBUSY;
+	}
+	last = journal->j_fc_last ? journal->j_fc_last : journal->j_last;
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + nblocks > last) {
+		spin_unlock(&journal->j_state_lock);
+		return -EINVAL;
+	}
+
+	journal->j_last = last;
+	sb->s_num_fc_blks = cpu_to_be32(nblocks);
+	if (nblocks)
+		sb->s_feature_incompat |=
+			cpu_to_be32(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	else
+		sb->s_feature_incompat &=
+			~cpu_to_be32(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	journal_fc_setup(journal);
+
+	journal->j_head = journal->j_tail = journal->j_first;
+	journal->j_free = journal->j_last - journal->j_first;
+	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
+	if (journal->j_fc_last)
+		journal->j_max_transaction_buffers =
+			(journal->j_last - journal->j_first) / 4;
+	spin_unlock(&journal->j_state_lock);
+
+	/* jbd2_journal_update_superblock() may skip a recovered sb */
+	mark_buffer_dirty(journal->j_sb_buffer);
+	return sync_dirty_buffer(journal->j_sb_buffer);
+}
+
+/*
+ * Give up the fast commit area of an empty log, so that tools which do
+ * not know about fast commits can use the journal.
+ */
+static void journal_fc_release(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+
+	sb->s_num_fc_blks = 0;
+	sb->s_feature_incompat &=
+		~cpu_to_be32(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	mark_buffer_dirty(journal->j_sb_buffer);
+	sync_dirty_buffer(journal->j_sb_buffer);
+}
+
+/**
+ * int jbd2_fc_begin_commit() - Start a fast commit.
+ * @journal: Journal to act on.
+ * @tid: The transaction the fast commit is for.
+ *
+ * Fails unless @tid is the running transaction and no transaction is
+ * committing, in which case the caller must fall back to a full commit.
+ * Waits for any other fast commit to finish first.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	DEFINE_WAIT(wait);
+
+	if (!journal->j_fc_last)
+		return -EOPNOTSUPP;
+
+	spin_lock(&journal->j_state_lock);
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		spin_unlock(&journal->j_state_lock);
+		schedule();
+		spin_lock(&journal->j_state_lock);
+		finish_wait(&journal->j_fc_wait, &wait);
+	}
+
+	transaction = journal->j_running_transaction;
+	if (is_journal_aborted(journal) ||
+	    (journal->j_flags & (JBD2_FLUSHED | JBD2_FC_REPLAY)) ||
+	    !transaction || transaction->t_tid != tid ||
+	    transaction->t_state != T_RUNNING ||
+	    journal->j_committing_transaction) {
+		spin_unlock(&journal->j_state_lock);
+		return -EAGAIN;
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+	return 0;
+}
+
+/**
+ * void jbd2_fc_end_commit() - Finish a fast commit.
+ * @journal: Journal to act on.
+ * @err: Result of the fast commit, only successful ones are counted.
+ */
+void jbd2_fc_end_commit(journal_t *journal, int err)
+{
+	if (!err) {
+		spin_lock(&journal->j_history_lock);
+		journal->j_stats.ts_fc++;
+		spin_unlock(&journal->j_history_lock);
+	}
+
+	spin_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/*
+ * Get the next free block of the fast commit area.  Only called between
+ * jbd2_fc_begin_commit() and jbd2_fc_end_commit(), which serialise all
+ * users of j_fc_off.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bhp)
+{
+	unsigned long long blocknr;
+	struct buffer_head *bh;
+	int err;
+
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last)
+		return -ENOSPC;
+
+	err = jbd2_journal_bmap(journal,
+				journal->j_fc_first + journal->j_fc_off,
+				&blocknr);
+	if (err)
+		return err;
+
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+	journal->j_fc_off++;
+	*bhp = bh;
+	return 0;
+}
+
+/*
+ * Write a fast commit block and wait for it.  As for the commit record,
+ * the barrier makes sure that the data written before is on disk first.
+ */
+int jbd2_fc_write_buf(journal_t *journal, struct buffer_head *bh)
+{
+	int barrier_done = 0;
+	int ret;
+
+	set_buffer_uptodate(bh);
+	mark_buffer_dirty(bh);
+	if (journal->j_flags & JBD2_BARRIER) {
+		set_buffer_ordered(bh);
+		barrier_done = 1;
+	}
+	ret = sync_dirty_buffer(bh);
+	if (barrier_done)
+		clear_buffer_ordered(bh);
+
+	if (ret == -EOPNOTSUPP && barrier_done) {
+		printk(KERN_WARNING
+		       "JBD2: barrier-based sync failed on %s - "
+		       "disabling barriers\n", journal->j_devname);
+		spin_lock(&journal->j_state_lock);
+		journal->j_flags &= ~JBD2_BARRIER;
+		spin_unlock(&journal->j_state_lock);
+
+		/* And try again, without the barrier */
+		set_buffer_uptodate(bh);
+		mark_buffer_dirty(bh);
+		ret = sync_dirty_buffer(bh);
+	}
+	return ret;
+}
+
+/*
+ * Read block @index of the fast commit area, for replay.
+ */
+struct buffer_head *jbd2_fc_read_buf(journal_t *journal, unsigned int index)
+{
+	unsigned long long blocknr;
+
+	if (journal->j_fc_first + index >= journal->j_fc_last)
+		return NULL;
+	if (jbd2_journal_bmap(journal, journal->j_fc_first + index, &blocknr))
+		return NULL;
+	return __bread(journal->j_dev, blocknr, journal->j_blocksize);
+}
+
 struct jbd2_stats_proc_session {
 	journal_t *journal;
 	struct transaction_stats_s *stats;
@@ -732,6 +980,7 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%lu fast commits\n", s->stats->ts_fc);
 	return 0;
 }
 
@@ -836,6 +1085,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_checkpoint);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1045,16 +1295,20 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	journal_fc_setup(journal);
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
 	journal->j_commit_request = journal->j_commit_sequence;
 
 	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
+	if (journal->j_fc_last)
+		journal->j_max_transaction_buffers =
+			(journal->j_last - journal->j_first) / 4;
 
 	/* Add the dynamic fields and write it to disk. */
 	jbd2_journal_update_superblock(journal, 1);
@@ -1223,6 +1477,7 @@ static int load_superblock(journal_t *journal)
 	journal->j_first = be32_to_cpu(sb->s_first);
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
+	journal_fc_setup(journal);
 
 	return 0;
 }
@@ -1336,6 +1591,9 @@ int jbd2_journal_destroy(journal_t *journal)
 			journal->j_tail = 0;
 			journal->j_tail_sequence =
 				++journal->j_transaction_sequence;
+			/* All fast commit records belong to committed ones */
+			if (journal->j_fc_last)
+				journal_fc_release(journal);
 			jbd2_journal_update_superblock(journal, 1);
 		} else {
 			err = -EIO;
@@ -541,6 +541,148 @@ const struct file_operations proc_clear_refs_operations = {
 	.write		= clear_refs_write,
 };
 
+/*
+ * /proc/pid/wss estimates the working set of a process: writing 1 clears
+ * the accessed bits of all its ptes, reading counts the resident pages
+ * accessed since then.  Unlike clear_refs, PG_referenced is left alone,
+ * as it does not tell which process touched the page.
+ */
+struct wss_stats {
+	struct vm_area_struct *vma;
+	unsigned long anon_young;
+	unsigned long file_young;
+	unsigned long anon;
+	unsigned long file;
+	bool clear;
+};
+
+static int wss_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
+			 struct mm_walk *walk)
+{
+	struct wss_stats *wss = walk->private;
+	struct vm_area_struct *vma = wss->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		if (wss->clear) {
+			ptep_test_and_clear_young(vma, addr, pte);
+			continue;
+		}
+
+		if (PageAnon(page)) {
+			wss->anon++;
+			if (pte_young(ptent))
+				wss->anon_young++;
+		} else {
+			wss->file++;
+			if (pte_young(ptent))
+				wss->file_young++;
+		}
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void wss_walk(struct mm_struct *mm, struct wss_stats *wss)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk wss_walk = {
+		.pmd_entry = wss_pte_range,
+		.mm = mm,
+		.private = wss,
+	};
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		wss->vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &wss_walk);
+	}
+	if (wss->clear)
+		flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+}
+
+static int wss_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct wss_stats wss = { .clear = false };
+	struct task_struct *task;
+	struct mm_struct *mm;
+
+	task = get_proc_task(inode);
+	if (!task)
+		return -ESRCH;
+	mm = mm_for_maps(task);
+	put_task_struct(task);
+	if (!mm)
+		return -EACCES;
+	wss_walk(mm, &wss);
+	mmput(mm);
+
+	seq_printf(m, "%lu %lu %lu %lu\n",
+		   wss.anon_young, wss.file_young, wss.anon, wss.file);
+	return 0;
+}
+
+static int wss_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wss_show, inode);
+}
+
+static ssize_t wss_write(struct file *file, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	struct wss_stats wss = { .clear = true };
+	char buffer[PROC_NUMBUF];
+	struct mm_struct *mm;
+	long val;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+	if (strict_strtol(strstrip(buffer), 10, &val))
+		return -EINVAL;
+	if (val != 1)
+		return -EINVAL;
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	/* Unlike clear_refs, resetting another process needs ptrace access */
+	mm = mm_for_maps(task);
+	put_task_struct(task);
+	if (!mm)
+		return -EACCES;
+	wss_walk(mm, &wss);
+	mmput(mm);
+
+	return count;
+}
+
+const struct file_operations proc_wss_operations = {
+	.open		= wss_open,
+	.read		= seq_read,
+	.write		= wss_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 struct pagemapread {
 	int pos, len;
 	u64 *buffer;
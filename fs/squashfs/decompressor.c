@@ -23,6 +23,11 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -40,9 +45,17 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
-static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
+#ifndef CONFIG_SQUASHFS_LZO
+static const struct squashfs_decompressor squashfs_lzo_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#endif
+
+#ifndef CONFIG_SQUASHFS_XZ
+static const struct squashfs_decompressor squashfs_xz_comp_ops = {
+	NULL, NULL, NULL, XZ_COMPRESSION, "xz", 0
+};
+#endif
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -51,7 +64,8 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
-	&squashfs_lzo_unsupported_comp_ops,
+	&squashfs_lzo_comp_ops,
+	&squashfs_xz_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +80,186 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * Each superblock has a pool of decompressor streams so that independent
+ * blocks can be decompressed concurrently.  The first stream is allocated
+ * at mount time, further ones are allocated on demand, up to max_streams,
+ * when a reader finds all the existing ones busy.  Streams are never
+ * freed before umount.
+ */
+struct squashfs_stream {
+	spinlock_t		lock;
+	struct list_head	idle;
+	int			nr_streams;
+	int			max_streams;
+	wait_queue_head_t	wait;
+
+	/* statistics */
+	unsigned long		decompressions;
+	unsigned long		waits;
+	u64			wait_ns;
+	u64			decompress_ns;
+};
+
+struct decomp_stream {
+	void			*stream;
+	struct list_head	list;
+};
+
+
+static struct decomp_stream *alloc_stream(struct squashfs_sb_info *msblk)
+{
+	struct decomp_stream *ds = kmalloc(sizeof(*ds), GFP_KERNEL);
+
+	if (ds == NULL)
+		return NULL;
+
+	ds->stream = msblk->decompressor->init(msblk);
+	if (ds->stream == NULL) {
+		kfree(ds);
+		return NULL;
+	}
+
+	return ds;
+}
+
+
+struct squashfs_stream *squashfs_decompressor_init(
+	struct squashfs_sb_info *msblk, int max_streams)
+{
+	struct squashfs_stream *s;
+	struct decomp_stream *ds;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (s == NULL)
+		return NULL;
+
+	ds = alloc_stream(msblk);
+	if (ds == NULL) {
+		kfree(s);
+		return NULL;
+	}
+
+	spin_lock_init(&s->lock);
+	INIT_LIST_HEAD(&s->idle);
+	init_waitqueue_head(&s->wait);
+	list_add(&ds->list, &s->idle);
+	s->nr_streams = 1;
+	s->max_streams = max_streams;
+
+	return s;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *s = msblk->stream;
+	struct decomp_stream *ds, *next;
+
+	if (s == NULL)
+		return;
+
+	list_for_each_entry_safe(ds, next, &s->idle, list) {
+		msblk->decompressor->free(ds->stream);
+		kfree(ds);
+	}
+	kfree(s);
+}
+
+
+/*
+ * Take an idle stream, allocating a new one if they are all busy and the
+ * pool may still grow.  If that fails too, wait for one to be released.
+ */
+static struct decomp_stream *get_stream(struct squashfs_sb_info *msblk,
+	int *waited)
+{
+	struct squashfs_stream *s = msblk->stream;
+	struct decomp_stream *ds;
+
+	spin_lock(&s->lock);
+	while (list_empty(&s->idle)) {
+		if (s->nr_streams < s->max_streams) {
+			s->nr_streams++;
+			spin_unlock(&s->lock);
+
+			ds = alloc_stream(msblk);
+			if (ds)
+				return ds;
+
+			spin_lock(&s->lock);
+			s->nr_streams--;
+			continue;
+		}
+
+		spin_unlock(&s->lock);
+		*waited = 1;
+		wait_event(s->wait, !list_empty(&s->idle));
+		spin_lock(&s->lock);
+	}
+
+	ds = list_entry(s->idle.next, struct decomp_stream, list);
+	list_del(&ds->list);
+	spin_unlock(&s->lock);
+
+	return ds;
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *s = msblk->stream;
+	struct decomp_stream *ds;
+	ktime_t start, got;
+	int waited = 0, res;
+
+	start = ktime_get();
+	ds = get_stream(msblk, &waited);
+	got = ktime_get();
+
+	res = msblk->decompressor->decompress(msblk, ds->stream, buffer, bh, b,
+		offset, length, srclength, pages);
+
+	spin_lock(&s->lock);
+	list_add(&ds->list, &s->idle);
+	s->decompressions++;
+	s->waits += waited;
+	s->wait_ns += ktime_to_ns(ktime_sub(got, start));
+	s->decompress_ns += ktime_to_ns(ktime_sub(ktime_get(), got));
+	spin_unlock(&s->lock);
+
+	wake_up(&s->wait);
+
+	return res;
+}
+
+
+void squashfs_decompressor_stats(struct seq_file *m,
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *s = msblk->stream;
+	unsigned long decompressions, waits;
+	u64 wait_ns, decompress_ns;
+	int nr_streams;
+
+	spin_lock(&s->lock);
+	nr_streams = s->nr_streams;
+	decompressions = s->decompressions;
+	waits = s->waits;
+	wait_ns = s->wait_ns;
+	decompress_ns = s->decompress_ns;
+	spin_unlock(&s->lock);
+
+	seq_printf(m, "decompressor:\t%s\n", msblk->decompressor->name);
+	seq_printf(m, "streams:\t%d (max %d)\n", nr_streams, s->max_streams);
+	seq_printf(m, "decompressions:\t%lu\n", decompressions);
+	seq_printf(m, "waits:\t\t%lu\n", waits);
+	seq_printf(m, "wait_us:\t%llu\n",
+		(unsigned long long)div_u64(wait_ns, NSEC_PER_USEC));
+	seq_printf(m, "decompress_us:\t%llu\n",
+		(unsigned long long)div_u64(decompress_ns, NSEC_PER_USEC));
+}
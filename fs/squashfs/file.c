@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/highmem.h>
 #include <linux/mutex.h>
 
 #include "squashfs_fs.h"
@@ -371,6 +372,104 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Decompress a datablock straight into the page cache pages covering it,
+ * avoiding the copy through the read_page cache.  This needs all of those
+ * pages: if any of them is missing, locked by someone else or already
+ * uptodate, nothing is done and -EAGAIN is returned so that the caller
+ * falls back to the cache.  On other errors the target page is left
+ * locked for the caller to handle.
+ */
+static int squashfs_readpage_direct(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	/* Not an error: the caller falls back to reading via the cache */
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL || (page[i] != target_page &&
+					PageUptodate(page[i]))) {
+			res = -EAGAIN;
+			goto release_pages;
+		}
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		msblk->block_size, pages);
+
+	/* Zero whatever the block did not fill, normally the file tail */
+	for (i = 0; res >= 0 && i < pages; i++) {
+		int avail = res - (i << PAGE_CACHE_SHIFT);
+
+		if (avail < PAGE_CACHE_SIZE)
+			memset(pageaddr[i] + max(avail, 0), 0,
+				PAGE_CACHE_SIZE - max(avail, 0));
+	}
+
+	for (i = 0; i < pages; i++) {
+		kunmap(page[i]);
+		if (res < 0 && page[i] == target_page)
+			continue;
+
+		flush_dcache_page(page[i]);
+		if (res < 0)
+			SetPageError(page[i]);
+		else
+			SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	if (res >= 0)
+		atomic_inc(&msblk->direct_reads);
+	goto out;
+
+release_pages:
+	for (i = 0; i < pages && page[i]; i++) {
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res < 0 ? res : 0;
+}
+#else
+static inline int squashfs_readpage_direct(struct page *target_page,
+	u64 block, int bsize)
+{
+	return -EAGAIN;
+}
+#endif
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -410,8 +509,18 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, directly into the
+			 * page cache if possible.
 			 */
+			int res = squashfs_readpage_direct(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN) {
+				ERROR("Unable to read page, block %llx, size %x"
+					"\n", block, bsize);
+				goto error_out;
+			}
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -420,6 +529,7 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				squashfs_cache_put(buffer);
 				goto error_out;
 			}
+			atomic_inc(&msblk->cached_reads);
 			bytes = buffer->length;
 		}
 	} else {
@@ -37,6 +37,10 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/cpumask.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -75,6 +79,138 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 }
 
 
+enum { Opt_streams, Opt_err };
+
+static const match_table_t tokens = {
+	{Opt_streams, "streams=%u"},
+	{Opt_err, NULL}
+};
+
+static int squashfs_parse_options(char *options, int *streams)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int option;
+
+	if (!options)
+		return 1;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, tokens, args)) {
+		case Opt_streams:
+			if (match_int(&args[0], &option) || option < 1)
+				return 0;
+			*streams = option;
+			break;
+		default:
+			ERROR("Unrecognized mount option \"%s\" or missing "
+				"value\n", p);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+#ifdef CONFIG_PROC_FS
+static struct proc_dir_entry *squashfs_proc_root;
+
+static int squashfs_streams_show(struct seq_file *m, void *v)
+{
+	squashfs_decompressor_stats(m, m->private);
+	return 0;
+}
+
+static int squashfs_streams_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_streams_show, PDE(inode)->data);
+}
+
+static const struct file_operations squashfs_streams_fops = {
+	.owner = THIS_MODULE,
+	.open = squashfs_streams_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void squashfs_cache_show(struct seq_file *m,
+	struct squashfs_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	seq_printf(m, "%-10s %7d %10d %10lu\n", cache->name, cache->entries,
+		cache->block_size,
+		(unsigned long)cache->entries * cache->pages * PAGE_CACHE_SIZE);
+}
+
+static int squashfs_cache_stats_show(struct seq_file *m, void *v)
+{
+	struct squashfs_sb_info *msblk = m->private;
+
+	seq_printf(m, "%-10s %7s %10s %10s\n", "cache", "entries",
+		"block_size", "bytes");
+	squashfs_cache_show(m, msblk->block_cache);
+	squashfs_cache_show(m, msblk->fragment_cache);
+	squashfs_cache_show(m, msblk->read_page);
+	seq_printf(m, "\ndirect_reads:\t%d\n",
+		atomic_read(&msblk->direct_reads));
+	seq_printf(m, "cached_reads:\t%d\n",
+		atomic_read(&msblk->cached_reads));
+	return 0;
+}
+
+static int squashfs_cache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_cache_stats_show, PDE(inode)->data);
+}
+
+static const struct file_operations squashfs_cache_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = squashfs_cache_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void squashfs_proc_init(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (squashfs_proc_root == NULL)
+		return;
+
+	msblk->proc = proc_mkdir(sb->s_id, squashfs_proc_root);
+	if (msblk->proc == NULL)
+		return;
+
+	proc_create_data("streams", S_IRUGO, msblk->proc,
+		&squashfs_streams_fops, msblk);
+	proc_create_data("cache", S_IRUGO, msblk->proc,
+		&squashfs_cache_stats_fops, msblk);
+}
+
+static void squashfs_proc_exit(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (msblk->proc) {
+		remove_proc_entry("streams", msblk->proc);
+		remove_proc_entry("cache", msblk->proc);
+		remove_proc_entry(sb->s_id, squashfs_proc_root);
+	}
+}
+#else
+static inline void squashfs_proc_init(struct super_block *sb) {}
+static inline void squashfs_proc_exit(struct super_block *sb) {}
+#endif
+
+
 static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
@@ -85,6 +221,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	unsigned short flags;
 	unsigned int fragments;
 	u64 lookup_table_start, xattr_id_table_start;
+	int streams = max_t(int, num_online_cpus(), 2);
 	int err;
 
 	TRACE("Entered squashfs_fill_superblock\n");
@@ -96,6 +233,12 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	}
 	msblk = sb->s_fs_info;
 
+	if (!squashfs_parse_options(data, &streams)) {
+		kfree(sb->s_fs_info);
+		sb->s_fs_info = NULL;
+		return -EINVAL;
+	}
+
 	sblk = kzalloc(sizeof(*sblk), GFP_KERNEL);
 	if (sblk == NULL) {
 		ERROR("Failed to allocate squashfs_super_block\n");
@@ -105,7 +248,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -200,7 +342,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	err = -ENOMEM;
 
-	msblk->stream = squashfs_decompressor_init(msblk);
+	msblk->stream = squashfs_decompressor_init(msblk, streams);
 	if (msblk->stream == NULL)
 		goto failed_mount;
 
@@ -299,6 +441,8 @@ allocate_root:
 		goto failed_mount;
 	}
 
+	squashfs_proc_init(sb);
+
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
@@ -307,7 +451,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
-	squashfs_decompressor_free(msblk, msblk->stream);
+	squashfs_decompressor_free(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -358,10 +502,11 @@ static void squashfs_put_super(struct super_block *sb)
 
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		squashfs_proc_exit(sb);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
-		squashfs_decompressor_free(sbi, sbi->stream);
+		squashfs_decompressor_free(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -424,6 +569,10 @@ static int __init init_squashfs_fs(void)
 		return err;
 	}
 
+#ifdef CONFIG_PROC_FS
+	squashfs_proc_root = proc_mkdir("fs/squashfs", NULL);
+#endif
+
 	printk(KERN_INFO "squashfs: version 4.0 (2009/01/31) "
 		"Phillip Lougher\n");
 
@@ -433,6 +582,9 @@ static int __init init_squashfs_fs(void)
 
 static void __exit exit_squashfs_fs(void)
 {
+#ifdef CONFIG_PROC_FS
+	remove_proc_entry("fs/squashfs", NULL);
+#endif
 	unregister_filesystem(&squashfs_fs_type);
 	destroy_inodecache();
 }
@@ -0,0 +1,67 @@
+/*
+ * Shared per-CPU compression transforms
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#ifndef _CRYPTO_PERCPU_COMP_H
+#define _CRYPTO_PERCPU_COMP_H
+
+#include <linux/crypto.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+
+/*
+ * One compression transform per possible CPU for an algorithm, shared by
+ * all the users of that algorithm: the working memory of a compressor
+ * (64KB for lzo) is allocated once per CPU, not once per device.
+ */
+struct crypto_percpu_comp {
+	struct list_head list;
+	struct crypto_comp * __percpu *tfms;
+	int users;
+	char name[CRYPTO_MAX_ALG_NAME];
+};
+
+struct crypto_percpu_comp *crypto_alloc_percpu_comp(const char *alg_name);
+void crypto_free_percpu_comp(struct crypto_percpu_comp *pc);
+
+static inline const char *crypto_percpu_comp_name(
+	struct crypto_percpu_comp *pc)
+{
+	return pc->name;
+}
+
+/*
+ * The transform of the current CPU is used with preemption disabled, so
+ * the callers must not sleep in between, but need no locking of their own.
+ * *dlen is the size of dst on entry and the length of the output on return.
+ */
+static inline int crypto_percpu_comp_compress(struct crypto_percpu_comp *pc,
+					      const u8 *src, unsigned int slen,
+					      u8 *dst, unsigned int *dlen)
+{
+	struct crypto_comp *tfm = *per_cpu_ptr(pc->tfms, get_cpu());
+	int err = crypto_comp_compress(tfm, src, slen, dst, dlen);
+
+	put_cpu();
+	return err;
+}
+
+static inline int crypto_percpu_comp_decompress(struct crypto_percpu_comp *pc,
+						const u8 *src, unsigned int slen,
+						u8 *dst, unsigned int *dlen)
+{
+	struct crypto_comp *tfm = *per_cpu_ptr(pc->tfms, get_cpu());
+	int err = crypto_comp_decompress(tfm, src, slen, dst, dlen);
+
+	put_cpu();
+	return err;
+}
+
+#endif	/* _CRYPTO_PERCPU_COMP_H */
@@ -19,9 +19,14 @@ extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 
+extern int sysctl_extfrag_proactive_threshold;
+
 extern int fragmentation_index(struct zone *zone, unsigned int order);
+extern int unusable_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask);
+extern bool compaction_suitable(struct zone *zone, int order);
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -40,6 +45,12 @@ static inline void defer_compaction(struct zone *zone)
 		zone->compact_defer_shift = COMPACT_MAX_DEFER_SHIFT;
 }
 
+/* Like compaction_deferred(), without counting this as a skipped attempt */
+static inline bool compaction_defer_pending(struct zone *zone)
+{
+	return zone->compact_considered < (1UL << zone->compact_defer_shift);
+}
+
 /* Returns true if compaction should be skipped this time */
 static inline bool compaction_deferred(struct zone *zone)
 {
@@ -49,7 +60,7 @@ static inline bool compaction_deferred(struct zone *zone)
 	if (++zone->compact_considered > defer_limit)
 		zone->compact_considered = defer_limit;
 
-	return zone->compact_considered < (1UL << zone->compact_defer_shift);
+	return compaction_defer_pending(zone);
 }
 
 #else
@@ -59,6 +70,15 @@ static inline unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	return COMPACT_CONTINUE;
 }
 
+static inline bool compaction_suitable(struct zone *zone, int order)
+{
+	return 0;
+}
+
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+}
+
 static inline void defer_compaction(struct zone *zone)
 {
 }
@@ -68,6 +88,11 @@ static inline bool compaction_deferred(struct zone *zone)
 	return 1;
 }
 
+static inline bool compaction_defer_pending(struct zone *zone)
+{
+	return 1;
+}
+
 #endif /* CONFIG_COMPACTION */
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
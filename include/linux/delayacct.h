@@ -41,6 +41,7 @@ extern int __delayacct_add_tsk(struct taskstats *, struct task_struct *);
 extern __u64 __delayacct_blkio_ticks(struct task_struct *);
 extern void __delayacct_freepages_start(void);
 extern void __delayacct_freepages_end(void);
+extern void __delayacct_blkio_latency(struct task_struct *, u64, u64);
 
 static inline int delayacct_is_task_waiting_on_io(struct task_struct *p)
 {
@@ -121,6 +122,29 @@ static inline void delayacct_freepages_end(void)
 		__delayacct_freepages_end();
 }
 
+#ifdef CONFIG_BLK_IO_LATENCY
+/*
+ * Histogram bucket of a block request latency: log2 of the latency in
+ * units of 1024 ns, the last bucket catching everything longer.
+ */
+static inline int delayacct_blkio_lat_bucket(u64 ns)
+{
+	return min(fls64(ns >> 10), TASKSTATS_BLKIO_LAT_BUCKETS - 1);
+}
+
+/* Called when a request allocated by @tsk completes */
+static inline void delayacct_blkio_latency(struct task_struct *tsk,
+					   u64 wait_ns, u64 service_ns)
+{
+	if (tsk->delays)
+		__delayacct_blkio_latency(tsk, wait_ns, service_ns);
+}
+#else
+static inline void delayacct_blkio_latency(struct task_struct *tsk,
+					   u64 wait_ns, u64 service_ns)
+{}
+#endif
+
 #else
 static inline void delayacct_set_flag(int flag)
 {}
@@ -147,6 +171,9 @@ static inline void delayacct_freepages_start(void)
 {}
 static inline void delayacct_freepages_end(void)
 {}
+static inline void delayacct_blkio_latency(struct task_struct *tsk,
+					   u64 wait_ns, u64 service_ns)
+{}
 
 #endif /* CONFIG_TASK_DELAY_ACCT */
 
@@ -37,6 +37,15 @@
  *
  * 7.14
  *  - add splice support to fuse device
+ *
+ * Passthrough extension (negotiated with FUSE_PASSTHROUGH, any 7.x):
+ *  - add FOPEN_PASSTHROUGH open flag and passthrough_fd field to
+ *    fuse_open_out
+ *
+ * Batch and max_pages extensions (negotiated with FUSE_BATCH and
+ * FUSE_MAX_PAGES, any 7.x):
+ *  - allow several requests per read and several replies per write
+ *  - add max_pages field to fuse_init_out
  */
 
 #ifndef _LINUX_FUSE_H
@@ -135,16 +144,24 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read, write and mmap go directly to the file open
+ *		      on passthrough_fd in the filesystem daemon
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 31)
 
 /**
  * INIT request/reply flags
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_PASSTHROUGH: filesystem may return FOPEN_PASSTHROUGH from open
+ * FUSE_BATCH: read may return several requests, write may carry several
+ *	       replies
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of pages
+ *		   in a read or write request
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -153,6 +170,9 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_MAX_PAGES		(1 << 29)
+#define FUSE_BATCH		(1 << 30)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -354,7 +374,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__u32	passthrough_fd;
 };
 
 struct fuse_release_in {
@@ -457,6 +477,8 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u16	max_pages;
+	__u16	padding;
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -241,7 +241,11 @@ typedef struct journal_superblock_s
 	__be32	s_max_trans_data;	/* Limit of data blocks per trans. */
 
 /* 0x0050 */
-	__u32	s_padding[44];
+	__u32	s_padding2;
+/* 0x0054 */
+	__be32	s_num_fc_blks;		/* Number of fast commit blocks */
+/* 0x0058 */
+	__u32	s_padding[42];
 
 /* 0x0100 */
 	__u8	s_users[16*48];		/* ids of all fs'es sharing the log */
@@ -263,13 +267,15 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000100
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -659,6 +665,7 @@ struct transaction_run_stats_s {
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fc;		/* fast commits */
 	struct transaction_run_stats_s run;
 };
 
@@ -849,6 +856,25 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area: the blocks from j_fc_first to one before
+	 * j_fc_last follow the log, j_fc_off of them are used by fast
+	 * commits of the running transaction.  All zero if the journal
+	 * has no fast commit area.  [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+
+	/*
+	 * After recovery, the transaction whose fast commits are to be
+	 * replayed by the filesystem, valid if JBD2_FC_REPLAY is set.
+	 */
+	tid_t			j_fc_replay_tid;
+
+	/* Wait queue for a fast commit to finish */
+	wait_queue_head_t	j_fc_wait;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -991,6 +1017,9 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* A fast commit is being
+						 * written */
+#define JBD2_FC_REPLAY	0x100	/* Fast commits wait for replay */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1126,6 +1155,14 @@ extern int	   jbd2_journal_errno      (journal_t *);
 extern void	   jbd2_journal_ack_err    (journal_t *);
 extern int	   jbd2_journal_clear_err  (journal_t *);
 extern int	   jbd2_journal_bmap(journal_t *, unsigned long, unsigned long long *);
+
+/* Fast commits */
+extern int	   jbd2_fc_init(journal_t *, unsigned int);
+extern int	   jbd2_fc_begin_commit(journal_t *, tid_t);
+extern void	   jbd2_fc_end_commit(journal_t *, int);
+extern int	   jbd2_fc_get_buf(journal_t *, struct buffer_head **);
+extern int	   jbd2_fc_write_buf(journal_t *, struct buffer_head *);
+extern struct buffer_head *jbd2_fc_read_buf(journal_t *, unsigned int);
 extern int	   jbd2_journal_force_commit(journal_t *);
 extern int	   jbd2_journal_file_inode(handle_t *handle, struct jbd2_inode *inode);
 extern int	   jbd2_journal_begin_ordered_truncate(journal_t *journal,
@@ -182,6 +182,9 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* map pages up to this offset */
+	pte_t *pte;			/* pte of pgoff, pte lock held */
 };
 
 /*
@@ -194,6 +197,10 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/* map the pages between vmf->pgoff and vmf->max_pgoff which are
+	 * ready without blocking, on a read fault before ->fault */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -1010,16 +1017,27 @@ static inline void sync_mm_rss(struct task_struct *task, struct mm_struct *mm)
  *
  * Note that 'shrink' will be passed nr_to_scan == 0 when the VM is
  * querying the cache size, so a fastpath for that case is appropriate.
+ *
+ * 'batch' is the number of objects 'shrink' is asked to scan at a time,
+ * SHRINK_BATCH if left 0.  A shrinker with a high fixed cost per call
+ * should ask for larger batches.
  */
 struct shrinker {
 	int (*shrink)(struct shrinker *, int nr_to_scan, gfp_t gfp_mask);
 	int seeks;	/* seeks to recreate an obj */
+	long batch;	/* objs to scan per call, 0 for default */
 
 	/* These are for internal use */
 	struct list_head list;
 	long nr;	/* objs pending delete */
+	int stalled;	/* cache size when a scan last freed nothing */
+	unsigned long nr_calls;		/* scanning calls */
+	unsigned long nr_freed;		/* objs freed by them */
+	unsigned long nr_skipped;	/* passes skipped while stalled */
+	u64 time_ns;			/* time spent in them */
 };
 #define DEFAULT_SEEKS 2 /* A good number if you don't know better. */
+#define SHRINK_BATCH 128
 extern void register_shrinker(struct shrinker *);
 extern void unregister_shrinker(struct shrinker *);
 
@@ -1310,6 +1328,7 @@ extern void truncate_inode_pages_range(struct address_space *,
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *, struct vm_fault *);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
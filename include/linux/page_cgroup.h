@@ -9,11 +9,14 @@
  * page_cgroup helps us identify information about the cgroup
  * All page cgroups are allocated at boot or memory hotplug event,
  * then the page cgroup for pfn always exists.
+ *
+ * There is no pointer back to the page: the page is found from the
+ * position of the page_cgroup in its array, whose id (node or section)
+ * is kept in the upper bits of the flags, see lookup_cgroup_page().
  */
 struct page_cgroup {
 	unsigned long flags;
 	struct mem_cgroup *mem_cgroup;
-	struct page *page;
 	struct list_head lru;		/* per cgroup LRU list */
 };
 
@@ -32,6 +35,7 @@ static inline void __init page_cgroup_init(void)
 #endif
 
 struct page_cgroup *lookup_page_cgroup(struct page *page);
+struct page *lookup_cgroup_page(struct page_cgroup *pc);
 
 enum {
 	/* flags for mem_cgroup */
@@ -41,8 +45,32 @@ enum {
 	PCG_ACCT_LRU, /* page has been accounted for */
 	PCG_FILE_MAPPED, /* page is accounted as "mapped" */
 	PCG_MIGRATION, /* under page migration */
+	NR_PCG_FLAGS,
 };
 
+#ifdef CONFIG_SPARSEMEM
+#define PCG_ARRAYID_WIDTH	SECTIONS_SHIFT
+#else
+#define PCG_ARRAYID_WIDTH	NODES_SHIFT
+#endif
+
+/* NODES_SHIFT may be 0: don't shift by BITS_PER_LONG then */
+#define PCG_ARRAYID_SHIFT	((BITS_PER_LONG - PCG_ARRAYID_WIDTH) * \
+				 (PCG_ARRAYID_WIDTH != 0))
+#define PCG_ARRAYID_MASK	((1UL << PCG_ARRAYID_WIDTH) - 1)
+
+static inline void set_page_cgroup_array_id(struct page_cgroup *pc,
+					    unsigned long id)
+{
+	pc->flags &= ~(PCG_ARRAYID_MASK << PCG_ARRAYID_SHIFT);
+	pc->flags |= (id & PCG_ARRAYID_MASK) << PCG_ARRAYID_SHIFT;
+}
+
+static inline unsigned long page_cgroup_array_id(struct page_cgroup *pc)
+{
+	return (pc->flags >> PCG_ARRAYID_SHIFT) & PCG_ARRAYID_MASK;
+}
+
 #define TESTPCGFLAG(uname, lname)			\
 static inline int PageCgroup##uname(struct page_cgroup *pc)	\
 	{ return test_bit(PCG_##lname, &pc->flags); }
@@ -86,12 +114,12 @@ TESTPCGFLAG(Migration, MIGRATION)
 
 static inline int page_cgroup_nid(struct page_cgroup *pc)
 {
-	return page_to_nid(pc->page);
+	return page_to_nid(lookup_cgroup_page(pc));
 }
 
 static inline enum zone_type page_cgroup_zid(struct page_cgroup *pc)
 {
-	return page_zonenum(pc->page);
+	return page_zonenum(lookup_cgroup_page(pc));
 }
 
 static inline void lock_page_cgroup(struct page_cgroup *pc)
@@ -88,6 +88,7 @@ struct sched_param {
 #include <linux/timer.h>
 #include <linux/hrtimer.h>
 #include <linux/task_io_accounting.h>
+#include <linux/taskstats.h>
 #include <linux/kobject.h>
 #include <linux/latencytop.h>
 #include <linux/cred.h>
@@ -758,6 +759,12 @@ struct task_delay_info {
 	struct timespec freepages_start, freepages_end;
 	u64 freepages_delay;	/* wait for memory reclaim */
 	u32 freepages_count;	/* total count of memory reclaim */
+
+#ifdef CONFIG_BLK_IO_LATENCY
+	/* log2 histograms of the requests allocated by this task */
+	u32 blkio_wait_hist[TASKSTATS_BLKIO_LAT_BUCKETS];	/* queue wait */
+	u32 blkio_service_hist[TASKSTATS_BLKIO_LAT_BUCKETS];	/* device time */
+#endif
 };
 #endif	/* CONFIG_TASK_DELAY_ACCT */
 
@@ -1126,6 +1133,20 @@ struct sched_statistics {
 };
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+#define SCHED_LAT_BUCKETS	20
+
+/*
+ * Log2 histograms, in units of 1024 ns, of the time tasks wait on a
+ * runqueue before running, after a wakeup and after being preempted.
+ * The last bucket catches everything longer.
+ */
+struct sched_lat_hist {
+	unsigned long		wakeup[SCHED_LAT_BUCKETS];
+	unsigned long		preempt[SCHED_LAT_BUCKETS];
+};
+#endif
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1227,6 +1248,11 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	u64 sched_lat_stamp;		/* queued at, 0 when not waiting */
+	int sched_lat_preempted;	/* queued by preemption, not wakeup */
+	struct sched_lat_hist sched_lat;
+#endif
 
 	struct list_head tasks;
 	struct plist_node pushable_tasks;
@@ -1704,6 +1730,7 @@ extern int task_free_unregister(struct notifier_block *n);
 #define PF_EXITING	0x00000004	/* getting shut down */
 #define PF_EXITPIDONE	0x00000008	/* pi exit done on shut down */
 #define PF_VCPU		0x00000010	/* I'm a virtual CPU */
+#define PF_WQ_WORKER	0x00000020	/* I'm a workqueue worker */
 #define PF_FORKNOEXEC	0x00000040	/* forked but didn't exec */
 #define PF_MCE_PROCESS  0x00000080      /* process policy on mce errors */
 #define PF_SUPERPRIV	0x00000100	/* used super-user privileges */
@@ -2506,6 +2533,9 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern int sched_group_set_latency_sensitive(struct task_group *tg, int val);
+extern int sched_group_set_contended_cap(struct task_group *tg,
+					 unsigned int cap);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
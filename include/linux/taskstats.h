@@ -33,9 +33,10 @@
  */
 
 
-#define TASKSTATS_VERSION	7
+#define TASKSTATS_VERSION	8
 #define TS_COMM_LEN		32	/* should be >= TASK_COMM_LEN
 					 * in linux/sched.h */
+#define TASKSTATS_BLKIO_LAT_BUCKETS	20	/* see blkio_wait_hist */
 
 struct taskstats {
 
@@ -163,6 +164,17 @@ struct taskstats {
 	/* Delay waiting for memory reclaim */
 	__u64	freepages_count;
 	__u64	freepages_delay_total;
+	/* version 7 ends here */
+
+	/* Block I/O request latency histograms, filled in only if
+	 * CONFIG_BLK_IO_LATENCY is set.  Requests are charged to the
+	 * task which allocated them.  Buckets are log2 of microseconds
+	 * (taken as 1024 ns): bucket 0 counts requests which took less
+	 * than 1 usec, bucket i those which took 2^(i-1) to 2^i usec and
+	 * the last bucket everything longer.
+	 */
+	__u64	blkio_wait_hist[TASKSTATS_BLKIO_LAT_BUCKETS];	/* queued to dispatched */
+	__u64	blkio_service_hist[TASKSTATS_BLKIO_LAT_BUCKETS]; /* dispatched to completed */
 };
 
 
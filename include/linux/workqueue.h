@@ -9,9 +9,11 @@
 #include <linux/linkage.h>
 #include <linux/bitops.h>
 #include <linux/lockdep.h>
+#include <linux/threads.h>
 #include <asm/atomic.h>
 
 struct workqueue_struct;
+struct cpu_workqueue_struct;
 
 struct work_struct;
 typedef void (*work_func_t)(struct work_struct *work);
@@ -22,12 +24,40 @@ typedef void (*work_func_t)(struct work_struct *work);
  */
 #define work_data_bits(work) ((unsigned long *)(&(work)->data))
 
+#define WORK_STRUCT_PENDING_BIT	0	/* T if work item pending execution */
+#define WORK_STRUCT_STATIC_BIT	1	/* static initializer (debugobjects) */
+#define WORK_STRUCT_LINKED_BIT	2	/* next work is linked to this one */
+#define WORK_STRUCT_DELAYED_BIT	3	/* work item is delayed by max_active */
+#define WORK_STRUCT_COLOR_SHIFT	4	/* color for workqueue flushing */
+#define WORK_STRUCT_COLOR_BITS	2
+
+#define WORK_STRUCT_PENDING	(1UL << WORK_STRUCT_PENDING_BIT)
+#define WORK_STRUCT_STATIC	(1UL << WORK_STRUCT_STATIC_BIT)
+#define WORK_STRUCT_LINKED	(1UL << WORK_STRUCT_LINKED_BIT)
+#define WORK_STRUCT_DELAYED	(1UL << WORK_STRUCT_DELAYED_BIT)
+
+/*
+ * flush_workqueue() callers are serialized, so two colors are enough
+ * to tell works queued before a flush from those queued after it.
+ * Barriers get WORK_NO_COLOR and never hold up a flush.
+ */
+#define WORK_NR_COLORS		2
+#define WORK_NO_COLOR		WORK_NR_COLORS
+
+/*
+ * The cpu_workqueue_struct pointer stored in the data word is aligned
+ * to (1 << WORK_STRUCT_FLAG_BITS), which leaves the low bits for flags.
+ */
+#define WORK_STRUCT_FLAG_BITS	(WORK_STRUCT_COLOR_SHIFT + WORK_STRUCT_COLOR_BITS)
+#define WORK_STRUCT_FLAG_MASK	((1UL << WORK_STRUCT_FLAG_BITS) - 1)
+#define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
+
+/* special cpu numbers for the worker pools */
+#define WORK_CPU_UNBOUND	NR_CPUS
+#define WORK_CPU_NONE		(NR_CPUS + 1)
+
 struct work_struct {
 	atomic_long_t data;
-#define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
-#define WORK_STRUCT_STATIC  1		/* static initializer (debugobjects) */
-#define WORK_STRUCT_FLAG_MASK (3UL)
-#define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
 #ifdef CONFIG_LOCKDEP
@@ -36,7 +66,7 @@ struct work_struct {
 };
 
 #define WORK_DATA_INIT()	ATOMIC_LONG_INIT(0)
-#define WORK_DATA_STATIC_INIT()	ATOMIC_LONG_INIT(2)
+#define WORK_DATA_STATIC_INIT()	ATOMIC_LONG_INIT(WORK_STRUCT_STATIC)
 
 struct delayed_work {
 	struct work_struct work;
@@ -162,7 +192,7 @@ static inline void destroy_work_on_stack(struct work_struct *work) { }
  * @work: The work item in question
  */
 #define work_pending(work) \
-	test_bit(WORK_STRUCT_PENDING, work_data_bits(work))
+	test_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))
 
 /**
  * delayed_work_pending - Find out whether a delayable work item is currently
@@ -177,16 +207,31 @@ static inline void destroy_work_on_stack(struct work_struct *work) { }
  * @work: The work item in question
  */
 #define work_clear_pending(work) \
-	clear_bit(WORK_STRUCT_PENDING, work_data_bits(work))
+	clear_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))
+
+
+/*
+ * Workqueue flags and constants.  Workqueues are front-ends to shared
+ * pools of worker threads; WQ_* flags select the pool and behaviour.
+ */
+enum {
+	WQ_FREEZEABLE		= 1 << 0, /* freeze during suspend */
+	WQ_UNBOUND		= 1 << 1, /* not bound to any cpu */
+	WQ_HIGHPRI		= 1 << 2, /* served by SCHED_FIFO workers */
+	WQ_RESCUER		= 1 << 3, /* has a rescue worker */
 
+	WQ_DYING		= 1 << 6, /* internal: workqueue is dying */
+
+	WQ_MAX_ACTIVE		= 512,	  /* max in-flight works per cpu */
+	WQ_DFL_ACTIVE		= WQ_MAX_ACTIVE / 2,
+};
 
 extern struct workqueue_struct *
-__create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+__alloc_workqueue_key(const char *name, unsigned int flags, int max_active,
+		      struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define alloc_workqueue(name, flags, max_active)		\
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -196,20 +241,27 @@ __create_workqueue_key(const char *name, int singlethread,
 	else							\
 		__lock_name = #name;				\
 								\
-	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+	__alloc_workqueue_key((name), (flags), (max_active),	\
+			      &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
-	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+#define alloc_workqueue(name, flags, max_active)		\
+	__alloc_workqueue_key((name), (flags), (max_active), NULL, NULL)
 #endif
 
-#define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
-#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
-#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
-#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
+/*
+ * The legacy constructors keep their one-work-at-a-time semantics by
+ * limiting max_active to 1, but no longer own any threads.  Queues on
+ * the memory reclaim path ask for a rescuer with alloc_workqueue().
+ */
+#define create_workqueue(name)					\
+	alloc_workqueue((name), 0, 1)
+#define create_rt_workqueue(name)				\
+	alloc_workqueue((name), WQ_HIGHPRI, 1)
+#define create_freezeable_workqueue(name)			\
+	alloc_workqueue((name), WQ_FREEZEABLE | WQ_UNBOUND, 1)
+#define create_singlethread_workqueue(name)			\
+	alloc_workqueue((name), WQ_UNBOUND, 1)
 
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
@@ -289,6 +341,12 @@ void cancel_rearming_delayed_work(struct delayed_work *work)
 	cancel_delayed_work_sync(work);
 }
 
+#ifdef CONFIG_FREEZER
+extern void freeze_workqueues_begin(void);
+extern bool freeze_workqueues_busy(void);
+extern void thaw_workqueues(void);
+#endif /* CONFIG_FREEZER */
+
 #ifndef CONFIG_SMP
 static inline long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg)
 {
@@ -104,6 +104,7 @@ int __delayacct_add_tsk(struct taskstats *d, struct task_struct *tsk)
 	unsigned long long t2, t3;
 	unsigned long flags;
 	struct timespec ts;
+	int i __maybe_unused;
 
 	/* Though tsk->delays accessed later, early exit avoids
 	 * unnecessary returning of other data
@@ -151,6 +152,12 @@ int __delayacct_add_tsk(struct taskstats *d, struct task_struct *tsk)
 	d->blkio_count += tsk->delays->blkio_count;
 	d->swapin_count += tsk->delays->swapin_count;
 	d->freepages_count += tsk->delays->freepages_count;
+#ifdef CONFIG_BLK_IO_LATENCY
+	for (i = 0; i < TASKSTATS_BLKIO_LAT_BUCKETS; i++) {
+		d->blkio_wait_hist[i] += tsk->delays->blkio_wait_hist[i];
+		d->blkio_service_hist[i] += tsk->delays->blkio_service_hist[i];
+	}
+#endif
 	spin_unlock_irqrestore(&tsk->delays->lock, flags);
 
 done:
@@ -169,6 +176,24 @@ __u64 __delayacct_blkio_ticks(struct task_struct *tsk)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_IO_LATENCY
+/*
+ * Called from the block layer, possibly in interrupt context, when a
+ * request allocated by @tsk completes.  @wait_ns is the time the
+ * request spent queued, @service_ns the time it spent in the driver.
+ */
+void __delayacct_blkio_latency(struct task_struct *tsk,
+			       u64 wait_ns, u64 service_ns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tsk->delays->lock, flags);
+	tsk->delays->blkio_wait_hist[delayacct_blkio_lat_bucket(wait_ns)]++;
+	tsk->delays->blkio_service_hist[delayacct_blkio_lat_bucket(service_ns)]++;
+	spin_unlock_irqrestore(&tsk->delays->lock, flags);
+}
+#endif
+
 void __delayacct_freepages_start(void)
 {
 	delayacct_start(&current->delays->freepages_start);
@@ -16,6 +16,7 @@
 #include <linux/freezer.h>
 #include <linux/delay.h>
 #include <linux/wakelock.h>
+#include <linux/workqueue.h>
 
 /* 
  * Timeout for stopping processes
@@ -40,10 +41,15 @@ static int try_to_freeze_tasks(bool sig_only)
 	u64 elapsed_csecs64;
 	unsigned int elapsed_csecs;
 	bool wakeup = false;
+	bool wq_busy = false;
 
 	do_gettimeofday(&start);
 
 	end_time = jiffies + TIMEOUT;
+
+	if (!sig_only)
+		freeze_workqueues_begin();
+
 	while (true) {
 		todo = 0;
 		read_lock(&tasklist_lock);
@@ -71,6 +77,12 @@ static int try_to_freeze_tasks(bool sig_only)
 				todo++;
 		} while_each_thread(g, p);
 		read_unlock(&tasklist_lock);
+
+		if (!sig_only) {
+			wq_busy = freeze_workqueues_busy();
+			todo += wq_busy;
+		}
+
 		if (todo && has_wake_lock(WAKE_LOCK_SUSPEND)) {
 			wakeup = 1;
 			break;
@@ -109,9 +121,10 @@ static int try_to_freeze_tasks(bool sig_only)
 		else {
 			printk("\n");
 			printk(KERN_ERR "Freezing of tasks %s after %d.%02d seconds "
-					"(%d tasks refusing to freeze):\n",
+					"(%d tasks refusing to freeze, wq_busy=%d):\n",
 					wakeup ? "aborted" : "failed",
-					elapsed_csecs / 100, elapsed_csecs % 100, todo);
+					elapsed_csecs / 100, elapsed_csecs % 100,
+					todo - wq_busy, wq_busy);
 		}
 		read_lock(&tasklist_lock);
 		do_each_thread(g, p) {
@@ -182,6 +195,7 @@ void thaw_processes(void)
 	oom_killer_enable();
 
 	printk("Restarting tasks ... ");
+	thaw_workqueues();
 	thaw_tasks(true);
 	thaw_tasks(false);
 	schedule();
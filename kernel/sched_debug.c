@@ -373,6 +373,93 @@ static int __init init_sched_debug_procfs(void)
 
 __initcall(init_sched_debug_procfs);
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static void print_lat_hist(struct seq_file *m, const char *name,
+			   unsigned long *hist)
+{
+	int i;
+
+	SEQ_printf(m, "%-35s:", name);
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		SEQ_printf(m, " %lu", hist[i]);
+	SEQ_printf(m, "\n");
+}
+
+static int sched_lat_hist_show(struct seq_file *m, void *v)
+{
+	unsigned long wakeup, preempt;
+	char name[16];
+	int cpu, i;
+
+	seq_printf(m, "%-15s %12s %12s\n", "usecs", "wakeup", "preempt");
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++) {
+		wakeup = preempt = 0;
+		for_each_possible_cpu(cpu) {
+			wakeup += cpu_rq(cpu)->lat_hist.wakeup[i];
+			preempt += cpu_rq(cpu)->lat_hist.preempt[i];
+		}
+		if (!i)
+			snprintf(name, sizeof(name), "<1");
+		else if (i == SCHED_LAT_BUCKETS - 1)
+			snprintf(name, sizeof(name), ">=%lu", 1UL << (i - 1));
+		else
+			snprintf(name, sizeof(name), "%lu-%lu",
+				 1UL << (i - 1), 1UL << i);
+		seq_printf(m, "%-15s %12lu %12lu\n", name, wakeup, preempt);
+	}
+
+	for_each_online_cpu(cpu) {
+		seq_printf(m, "\ncpu#%d\n", cpu);
+		print_lat_hist(m, "wakeup", cpu_rq(cpu)->lat_hist.wakeup);
+		print_lat_hist(m, "preempt", cpu_rq(cpu)->lat_hist.preempt);
+	}
+
+	return 0;
+}
+
+static ssize_t
+sched_lat_hist_write(struct file *filp, const char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	struct rq *rq;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		raw_spin_lock_irq(&rq->lock);
+		memset(&rq->lat_hist, 0, sizeof(rq->lat_hist));
+		raw_spin_unlock_irq(&rq->lock);
+	}
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static int sched_lat_hist_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_lat_hist_show, NULL);
+}
+
+static const struct file_operations sched_lat_hist_fops = {
+	.open		= sched_lat_hist_open,
+	.write		= sched_lat_hist_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init init_sched_lat_hist_debugfs(void)
+{
+	debugfs_create_file("sched_latency_hist", 0644, NULL, NULL,
+			    &sched_lat_hist_fops);
+
+	return 0;
+}
+
+__initcall(init_sched_lat_hist_debugfs);
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 {
 	unsigned long nr_switches;
@@ -456,6 +543,10 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.load.weight);
 	P(policy);
 	P(prio);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	print_lat_hist(m, "sched_lat.wakeup", p->sched_lat.wakeup);
+	print_lat_hist(m, "sched_lat.preempt", p->sched_lat.preempt);
+#endif
 #undef PN
 #undef __PN
 #undef P
@@ -477,4 +568,7 @@ void proc_sched_set_task(struct task_struct *p)
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	memset(&p->sched_lat, 0, sizeof(p->sched_lat));
+#endif
 }
@@ -205,6 +205,69 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 	}
 }
 
+/*
+ * The group a task entity belongs to, or the group a group entity
+ * stands for.
+ */
+static inline struct task_group *entity_tg(struct sched_entity *se)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+
+	return my_q ? my_q->tg : cfs_rq_of(se)->tg;
+}
+
+static inline int entity_latency_sensitive(struct sched_entity *se)
+{
+	struct task_group *tg;
+
+	for (tg = entity_tg(se); tg; tg = tg->parent) {
+		if (tg->latency_sensitive)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Length of the window a group's contended_cap is enforced over. */
+#define SCHED_CAP_WINDOW	(100 * NSEC_PER_MSEC)
+
+static inline void
+account_cap_exec(struct sched_entity *se, u64 now, unsigned long delta_exec)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+
+	if (!my_q || !my_q->tg->contended_cap)
+		return;
+
+	if (now - my_q->cap_window_start > SCHED_CAP_WINDOW) {
+		my_q->cap_window_start = now;
+		my_q->cap_window_exec = 0;
+	}
+	my_q->cap_window_exec += delta_exec;
+}
+
+/*
+ * Has the group entity @se used up its contended_cap in the current
+ * window?  It is then only run when nothing else is runnable.
+ */
+static inline int entity_over_cap(struct sched_entity *se)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+	unsigned int cap;
+
+	if (!my_q)
+		return 0;
+
+	cap = my_q->tg->contended_cap;
+	if (!cap)
+		return 0;
+
+	if (rq_of(my_q)->clock_task - my_q->cap_window_start > SCHED_CAP_WINDOW)
+		return 0;
+
+	return my_q->cap_window_exec * 100 > (u64)cap * SCHED_CAP_WINDOW;
+}
+
 #else	/* !CONFIG_FAIR_GROUP_SCHED */
 
 static inline struct task_struct *task_of(struct sched_entity *se)
@@ -265,6 +328,21 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 {
 }
 
+static inline int entity_latency_sensitive(struct sched_entity *se)
+{
+	return 0;
+}
+
+static inline void
+account_cap_exec(struct sched_entity *se, u64 now, unsigned long delta_exec)
+{
+}
+
+static inline int entity_over_cap(struct sched_entity *se)
+{
+	return 0;
+}
+
 #endif	/* CONFIG_FAIR_GROUP_SCHED */
 
 
@@ -535,6 +613,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		return;
 
 	__update_curr(cfs_rq, curr, delta_exec);
+	account_cap_exec(curr, now, delta_exec);
 	curr->exec_start = now;
 
 	if (entity_is_task(curr)) {
@@ -743,9 +822,11 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 
 		/*
 		 * Halve their sleep time's effect, to allow
-		 * for a gentler effect of sleepers:
+		 * for a gentler effect of sleepers, except for
+		 * latency sensitive groups:
 		 */
-		if (sched_feat(GENTLE_FAIR_SLEEPERS))
+		if (sched_feat(GENTLE_FAIR_SLEEPERS) &&
+		    !entity_latency_sensitive(se))
 			thresh >>= 1;
 
 		vruntime -= thresh;
@@ -849,6 +930,15 @@ check_preempt_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 {
 	unsigned long ideal_runtime, delta_exec;
 
+	/*
+	 * A group over its contended_cap yields to anything else.
+	 */
+	if (cfs_rq->nr_running > 1 && entity_over_cap(curr)) {
+		resched_task(rq_of(cfs_rq)->curr);
+		clear_buddies(cfs_rq, curr);
+		return;
+	}
+
 	ideal_runtime = sched_slice(cfs_rq, curr);
 	delta_exec = curr->sum_exec_runtime - curr->prev_sum_exec_runtime;
 	if (delta_exec > ideal_runtime) {
@@ -917,18 +1007,42 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 static int
 wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
 
+/*
+ * Skip group entities which are over their contended_cap, unless
+ * nothing else is runnable.
+ */
+static struct sched_entity *__pick_uncapped_entity(struct sched_entity *se)
+{
+	struct sched_entity *left = se;
+	struct rb_node *next;
+
+	while (entity_over_cap(se)) {
+		next = rb_next(&se->run_node);
+		if (!next)
+			return left;
+		se = rb_entry(next, struct sched_entity, run_node);
+	}
+
+	return se;
+}
+
 static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *se = __pick_next_entity(cfs_rq);
-	struct sched_entity *left = se;
+	struct sched_entity *left;
 
-	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, left) < 1)
+	se = __pick_uncapped_entity(se);
+	left = se;
+
+	if (cfs_rq->next && !entity_over_cap(cfs_rq->next) &&
+	    wakeup_preempt_entity(cfs_rq->next, left) < 1)
 		se = cfs_rq->next;
 
 	/*
 	 * Prefer last buddy, try to return the CPU to a preempted task.
 	 */
-	if (cfs_rq->last && wakeup_preempt_entity(cfs_rq->last, left) < 1)
+	if (cfs_rq->last && !entity_over_cap(cfs_rq->last) &&
+	    wakeup_preempt_entity(cfs_rq->last, left) < 1)
 		se = cfs_rq->last;
 
 	clear_buddies(cfs_rq, se);
@@ -1588,6 +1702,16 @@ wakeup_gran(struct sched_entity *curr, struct sched_entity *se)
 {
 	unsigned long gran = sysctl_sched_wakeup_granularity;
 
+	/*
+	 * Latency sensitive groups preempt the others as soon as they
+	 * are behind, and each other with a quarter of the granularity.
+	 */
+	if (entity_latency_sensitive(se)) {
+		if (!entity_latency_sensitive(curr))
+			return 0;
+		gran >>= 2;
+	}
+
 	/*
 	 * Since its curr running now, convert the gran from real-time
 	 * to virtual-time in his units.
@@ -1698,7 +1822,7 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	update_curr(cfs_rq);
 	find_matching_se(&se, &pse);
 	BUG_ON(!pse);
-	if (wakeup_preempt_entity(se, pse) == 1)
+	if (entity_over_cap(se) || wakeup_preempt_entity(se, pse) == 1)
 		goto preempt;
 
 	return;
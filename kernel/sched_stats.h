@@ -276,6 +276,63 @@ sched_info_switch(struct task_struct *prev, struct task_struct *next)
 #define sched_info_switch(t, next)		do { } while (0)
 #endif /* CONFIG_SCHEDSTATS || CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static inline int sched_lat_bucket(u64 ns)
+{
+	return min(fls64(ns >> 10), SCHED_LAT_BUCKETS - 1);
+}
+
+/*
+ * Called when @p has been woken up and queued on @rq: it is now
+ * waiting to run.
+ */
+static inline void sched_lat_wakeup(struct rq *rq, struct task_struct *p)
+{
+	p->sched_lat_stamp = rq->clock;
+	p->sched_lat_preempted = 0;
+}
+
+/*
+ * Called with rq->lock held when @next replaces @prev on the cpu.
+ * Account how long @next waited, in its own and in the runqueue's
+ * histograms, and start the clock on @prev if it is still runnable.
+ */
+static inline void
+sched_lat_switch(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next)
+{
+	if (prev->se.on_rq) {
+		prev->sched_lat_stamp = rq->clock;
+		prev->sched_lat_preempted = 1;
+	}
+
+	if (next->sched_lat_stamp) {
+		s64 delta = rq->clock - next->sched_lat_stamp;
+		int i;
+
+		/* the task may have been queued on another cpu's clock */
+		i = sched_lat_bucket(max_t(s64, delta, 0));
+		if (next->sched_lat_preempted) {
+			next->sched_lat.preempt[i]++;
+			rq->lat_hist.preempt[i]++;
+		} else {
+			next->sched_lat.wakeup[i]++;
+			rq->lat_hist.wakeup[i]++;
+		}
+		next->sched_lat_stamp = 0;
+	}
+}
+#else
+static inline void sched_lat_wakeup(struct rq *rq, struct task_struct *p)
+{
+}
+static inline void
+sched_lat_switch(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next)
+{
+}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 /*
  * The following are functions that support scheduler-internal time accounting.
  * These functions are generally called at the timer tick.  None of this depends
@@ -0,0 +1,122 @@
+/*
+ * Workqueue queue-to-execution latency test module
+ *
+ * Queues a batch of timestamped probe works on the kernel-global
+ * workqueue, once on an otherwise idle queue and once right behind a
+ * work which blocks for a while, and reports how long the probes had
+ * to wait before they started executing.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+static int nr_probes = 32;
+module_param(nr_probes, int, 0444);
+MODULE_PARM_DESC(nr_probes, "Number of probe works per round");
+
+static int block_ms = 100;
+module_param(block_ms, int, 0444);
+MODULE_PARM_DESC(block_ms, "How long the blocking work sleeps (ms)");
+
+struct wq_probe {
+	struct work_struct	work;
+	ktime_t			queued;
+	s64			latency_ns;
+};
+
+static atomic_t probes_left;
+static DECLARE_COMPLETION(probes_done);
+
+static void wq_probe_func(struct work_struct *work)
+{
+	struct wq_probe *probe = container_of(work, struct wq_probe, work);
+
+	probe->latency_ns = ktime_to_ns(ktime_sub(ktime_get(), probe->queued));
+	if (atomic_dec_and_test(&probes_left))
+		complete(&probes_done);
+}
+
+static void wq_block_func(struct work_struct *work)
+{
+	msleep(block_ms);
+}
+
+static DECLARE_WORK(wq_block_work, wq_block_func);
+
+static void wq_latency_round(struct wq_probe *probes, bool block)
+{
+	s64 min = LLONG_MAX, max = 0, total = 0;
+	int i, cpu;
+
+	INIT_COMPLETION(probes_done);
+	atomic_set(&probes_left, nr_probes);
+
+	/* queue everything on the same cpu so that the probes share a pool */
+	cpu = get_cpu();
+	if (block)
+		schedule_work_on(cpu, &wq_block_work);
+	for (i = 0; i < nr_probes; i++) {
+		INIT_WORK(&probes[i].work, wq_probe_func);
+		probes[i].queued = ktime_get();
+		schedule_work_on(cpu, &probes[i].work);
+	}
+	put_cpu();
+
+	wait_for_completion(&probes_done);
+	flush_work(&wq_block_work);
+
+	for (i = 0; i < nr_probes; i++) {
+		s64 lat = probes[i].latency_ns;
+
+		min = min(min, lat);
+		max = max(max, lat);
+		total += lat;
+	}
+
+	printk(KERN_INFO "wq_latency: %-12s cpu%d %d probes: "
+	       "min %lld avg %lld max %lld us\n",
+	       block ? "with blocker" : "idle", cpu, nr_probes,
+	       (long long)div_s64(min, NSEC_PER_USEC),
+	       (long long)div_s64(div_s64(total, nr_probes), NSEC_PER_USEC),
+	       (long long)div_s64(max, NSEC_PER_USEC));
+}
+
+static int wq_latency_test_init(void)
+{
+	struct wq_probe *probes;
+
+	if (nr_probes <= 0 || block_ms < 0)
+		return -EINVAL;
+
+	probes = kcalloc(nr_probes, sizeof(*probes), GFP_KERNEL);
+	if (!probes)
+		return -ENOMEM;
+
+	printk(KERN_INFO "wq_latency: blocking work sleeps %d ms\n", block_ms);
+	wq_latency_round(probes, false);
+	wq_latency_round(probes, true);
+
+	kfree(probes);
+	return 0;
+}
+
+static void wq_latency_test_exit(void)
+{
+}
+
+module_init(wq_latency_test_init);
+module_exit(wq_latency_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Workqueue queue-to-execution latency test");
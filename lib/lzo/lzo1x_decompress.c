@@ -9,6 +9,14 @@
  *  Changed for kernel use by:
  *  Nitin Gupta <nitingupta910@gmail.com>
  *  Richard Purdie <rpurdie@openedhand.com>
+ *
+ *  Where unaligned words are cheap (LZO_UNALIGNED_OK_4), literal runs and
+ *  matches far enough behind are copied 8 bytes at a time whenever the
+ *  buffers have room for the last chunk to run past the end of the copy.
+ *  The bytes written past it are overwritten by the next copies or lie
+ *  beyond the returned length, and every bounds check is still made before
+ *  the copy, so the result and the error returned for any input are the
+ *  same as with the byte copies.
  */
 
 #ifndef STATIC
@@ -24,9 +32,6 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
-
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
 {
@@ -72,6 +77,22 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
+#ifdef LZO_UNALIGNED_OK_4
+		/* t + 3 literals, in chunks which may overrun by 7 bytes */
+		if (likely(!HAVE_OP(t + 3 + 7, op_end, op) &&
+			   !HAVE_IP(t + 3 + 7, ip_end, ip))) {
+			const unsigned char *lit_end = ip + t + 3;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < lit_end);
+			op -= ip - lit_end;
+			ip = lit_end;
+			goto first_literal_run;
+		}
+#endif
 		COPY4(op, ip);
 		op += 4;
 		ip += 4;
@@ -108,6 +129,14 @@ first_literal_run:
 
 		if (HAVE_OP(3, op_end, op))
 			goto output_overrun;
+#ifdef LZO_UNALIGNED_OK_4
+		/* The match is at least 2049 bytes behind */
+		if (likely(!HAVE_OP(4, op_end, op))) {
+			COPY4(op, m_pos);
+			op += 3;
+			goto match_done;
+		}
+#endif
 		*op++ = *m_pos++;
 		*op++ = *m_pos++;
 		*op++ = *m_pos;
@@ -183,6 +212,40 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
+copy_match:
+			/* t + 2 bytes from m_pos, which may overlap op */
+#ifdef LZO_UNALIGNED_OK_4
+			if (op - m_pos >= 8 &&
+			    likely(!HAVE_OP(t + 2 + 7, op_end, op))) {
+				unsigned char * const cpy_end = op + t + 2;
+
+				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+				} while (op < cpy_end);
+				op = cpy_end;
+				goto match_done;
+			}
+			if (op - m_pos >= 4 &&
+			    likely(!HAVE_OP(t + 2 + 3, op_end, op))) {
+				unsigned char * const cpy_end = op + t + 2;
+
+				do {
+					COPY4(op, m_pos);
+					op += 4;
+					m_pos += 4;
+				} while (op < cpy_end);
+				op = cpy_end;
+				goto match_done;
+			}
+			if (op - m_pos == 1) {
+				/* A run of one byte */
+				memset(op, *m_pos, t + 2);
+				op += t + 2;
+				goto match_done;
+			}
+#endif
 			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
@@ -199,7 +262,6 @@ match:
 						*op++ = *m_pos++;
 					} while (--t > 0);
 			} else {
-copy_match:
 				*op++ = *m_pos++;
 				*op++ = *m_pos++;
 				do {
@@ -216,6 +278,16 @@ match_next:
 			if (HAVE_IP(t + 1, ip_end, ip))
 				goto input_overrun;
 
+#ifdef LZO_UNALIGNED_OK_4
+			if (likely(!HAVE_OP(4, op_end, op) &&
+				   !HAVE_IP(4, ip_end, ip))) {
+				COPY4(op, ip);
+				op += t;
+				ip += t;
+				t = *ip++;
+				continue;
+			}
+#endif
 			*op++ = *ip++;
 			if (t > 1) {
 				*op++ = *ip++;
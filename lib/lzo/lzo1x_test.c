@@ -0,0 +1,524 @@
+/*
+ * LZO1X decompressor self-test and benchmark module
+ *
+ * Compresses a set of pages with lzo1x_1_compress() and checks that
+ * lzo1x_decompress_safe() agrees with the plain byte copying decompressor
+ * it replaced, which is kept below as a reference: same return code, same
+ * output length and same output, for the intact streams as well as for
+ * truncated and corrupted ones and for output buffers that are too small,
+ * and nothing written past the end of the output buffer.  Then times both
+ * decompressors over the same pages.
+ *
+ * The pages are read from the file given as the corpus parameter, which
+ * should hold whole pages of real data, e.g. the anonymous memory of a
+ * running application as dumped by Documentation/vm/dump-anon.c.
+ * Without it, pages with a mix of zeroes, small integers, pointers, text
+ * and random bytes are made up.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <asm/unaligned.h>
+
+#include "lzodefs.h"
+
+static char *corpus;
+module_param(corpus, charp, 0444);
+MODULE_PARM_DESC(corpus, "File of page dumps to test with");
+
+static int nr_pages = 256;
+module_param(nr_pages, int, 0444);
+MODULE_PARM_DESC(nr_pages, "Maximum number of pages to test with");
+
+static int loops = 20;
+module_param(loops, int, 0444);
+MODULE_PARM_DESC(loops, "Number of passes over the pages when timing");
+
+#define HAVE_IP(x, ip_end, ip) ((size_t)(ip_end - ip) < (x))
+#define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
+#define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
+
+#define REF_COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+
+/* The decompressor as it was before the word copies */
+static noinline int lzo1x_decompress_ref(const unsigned char *in,
+		size_t in_len, unsigned char *out, size_t *out_len)
+{
+	const unsigned char * const ip_end = in + in_len;
+	unsigned char * const op_end = out + *out_len;
+	const unsigned char *ip = in, *m_pos;
+	unsigned char *op = out;
+	size_t t;
+
+	*out_len = 0;
+
+	if (*ip > 17) {
+		t = *ip++ - 17;
+		if (t < 4)
+			goto match_next;
+		if (HAVE_OP(t, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 1, ip_end, ip))
+			goto input_overrun;
+		do {
+			*op++ = *ip++;
+		} while (--t > 0);
+		goto first_literal_run;
+	}
+
+	while ((ip < ip_end)) {
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		if (t == 0) {
+			if (HAVE_IP(1, ip_end, ip))
+				goto input_overrun;
+			while (*ip == 0) {
+				t += 255;
+				ip++;
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
+			}
+			t += 15 + *ip++;
+		}
+		if (HAVE_OP(t + 3, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 4, ip_end, ip))
+			goto input_overrun;
+
+		REF_COPY4(op, ip);
+		op += 4;
+		ip += 4;
+		if (--t > 0) {
+			if (t >= 4) {
+				do {
+					REF_COPY4(op, ip);
+					op += 4;
+					ip += 4;
+					t -= 4;
+				} while (t >= 4);
+				if (t > 0) {
+					do {
+						*op++ = *ip++;
+					} while (--t > 0);
+				}
+			} else {
+				do {
+					*op++ = *ip++;
+				} while (--t > 0);
+			}
+		}
+
+first_literal_run:
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		m_pos = op - (1 + M2_MAX_OFFSET);
+		m_pos -= t >> 2;
+		m_pos -= *ip++ << 2;
+
+		if (HAVE_LB(m_pos, out, op))
+			goto lookbehind_overrun;
+
+		if (HAVE_OP(3, op_end, op))
+			goto output_overrun;
+		*op++ = *m_pos++;
+		*op++ = *m_pos++;
+		*op++ = *m_pos;
+
+		goto match_done;
+
+		do {
+match:
+			if (t >= 64) {
+				m_pos = op - 1;
+				m_pos -= (t >> 2) & 7;
+				m_pos -= *ip++ << 3;
+				t = (t >> 5) - 1;
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(t + 3 - 1, op_end, op))
+					goto output_overrun;
+				goto copy_match;
+			} else if (t >= 32) {
+				t &= 31;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 31 + *ip++;
+				}
+				m_pos = op - 1;
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+			} else if (t >= 16) {
+				m_pos = op;
+				m_pos -= (t & 8) << 11;
+
+				t &= 7;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 7 + *ip++;
+				}
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+				if (m_pos == op)
+					goto eof_found;
+				m_pos -= 0x4000;
+			} else {
+				m_pos = op - 1;
+				m_pos -= t >> 2;
+				m_pos -= *ip++ << 2;
+
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(2, op_end, op))
+					goto output_overrun;
+
+				*op++ = *m_pos++;
+				*op++ = *m_pos;
+				goto match_done;
+			}
+
+			if (HAVE_LB(m_pos, out, op))
+				goto lookbehind_overrun;
+			if (HAVE_OP(t + 3 - 1, op_end, op))
+				goto output_overrun;
+
+			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
+				REF_COPY4(op, m_pos);
+				op += 4;
+				m_pos += 4;
+				t -= 4 - (3 - 1);
+				do {
+					REF_COPY4(op, m_pos);
+					op += 4;
+					m_pos += 4;
+					t -= 4;
+				} while (t >= 4);
+				if (t > 0)
+					do {
+						*op++ = *m_pos++;
+					} while (--t > 0);
+			} else {
+copy_match:
+				*op++ = *m_pos++;
+				*op++ = *m_pos++;
+				do {
+					*op++ = *m_pos++;
+				} while (--t > 0);
+			}
+match_done:
+			t = ip[-2] & 3;
+			if (t == 0)
+				break;
+match_next:
+			if (HAVE_OP(t, op_end, op))
+				goto output_overrun;
+			if (HAVE_IP(t + 1, ip_end, ip))
+				goto input_overrun;
+
+			*op++ = *ip++;
+			if (t > 1) {
+				*op++ = *ip++;
+				if (t > 2)
+					*op++ = *ip++;
+			}
+
+			t = *ip++;
+		} while (ip < ip_end);
+	}
+
+	*out_len = op - out;
+	return LZO_E_EOF_NOT_FOUND;
+
+eof_found:
+	*out_len = op - out;
+	return (ip == ip_end ? LZO_E_OK :
+		(ip < ip_end ? LZO_E_INPUT_NOT_CONSUMED : LZO_E_INPUT_OVERRUN));
+input_overrun:
+	*out_len = op - out;
+	return LZO_E_INPUT_OVERRUN;
+
+output_overrun:
+	*out_len = op - out;
+	return LZO_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*out_len = op - out;
+	return LZO_E_LOOKBEHIND_OVERRUN;
+}
+
+/* Room past the end of the output buffer to catch stray writes */
+#define GUARD_SIZE	64
+#define GUARD_BYTE	0xa5
+
+static u8 *pages;		/* nr_pages uncompressed pages */
+static u8 *cdata;		/* and compressed, cmax bytes apart */
+static size_t *clens;
+static size_t cmax;
+static u8 *cbuf, *out_ref, *out_new;
+static struct rnd_state rnd;
+
+static int lzo_test_load(void)
+{
+	struct file *file;
+	int n, ret;
+
+	file = filp_open(corpus, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	for (n = 0; n < nr_pages; n++) {
+		ret = kernel_read(file, (loff_t)n * PAGE_SIZE,
+				  pages + n * PAGE_SIZE, PAGE_SIZE);
+		if (ret != PAGE_SIZE)
+			break;
+	}
+	filp_close(file, NULL);
+
+	if (!n)
+		return -ENODATA;
+	nr_pages = n;
+	return 0;
+}
+
+static void lzo_test_fill(u8 *p)
+{
+	u8 *end = p + PAGE_SIZE;
+
+	while (p < end) {
+		unsigned int r = prandom32(&rnd);
+		unsigned int len = min_t(unsigned int, 8 + (r >> 8) % 248,
+					 end - p);
+		unsigned int i;
+
+		switch (r % 5) {
+		case 0:
+			memset(p, 0, len);
+			break;
+		case 1:		/* small integers */
+			for (i = 0; i < len; i++)
+				p[i] = (i & 3) ? 0 : prandom32(&rnd) & 15;
+			break;
+		case 2:		/* pointers into a few pages */
+			for (i = 0; i < len; i++)
+				p[i] = (i & 3) == 3 ? 0xc0 :
+				       (i & 3) == 2 ? 0x3a :
+				       (i & 3) == 1 ? prandom32(&rnd) & 15 :
+				       prandom32(&rnd) & 0xfc;
+			break;
+		case 3:		/* text */
+			for (i = 0; i < len; i++)
+				p[i] = "etaoin shrdlu"[prandom32(&rnd) % 13];
+			break;
+		default:
+			for (i = 0; i < len; i++)
+				p[i] = prandom32(&rnd);
+			break;
+		}
+		p += len;
+	}
+}
+
+/* Decompress with both, from in to a buffer of cap bytes, and compare */
+static int lzo_test_one(int page, const char *what, const u8 *in,
+			size_t in_len, size_t cap)
+{
+	size_t len_ref = cap, len_new = cap, i;
+	int ret_ref, ret_new;
+
+	memset(out_ref, GUARD_BYTE, PAGE_SIZE + GUARD_SIZE);
+	memset(out_new, GUARD_BYTE, PAGE_SIZE + GUARD_SIZE);
+
+	ret_ref = lzo1x_decompress_ref(in, in_len, out_ref, &len_ref);
+	ret_new = lzo1x_decompress_safe(in, in_len, out_new, &len_new);
+
+	if (ret_ref != ret_new || len_ref != len_new ||
+	    memcmp(out_ref, out_new, len_ref))
+		goto fail;
+	for (i = cap; i < PAGE_SIZE + GUARD_SIZE; i++)
+		if (out_new[i] != GUARD_BYTE)
+			goto fail;
+	return 0;
+
+fail:
+	printk(KERN_ERR "lzo_test: page %d %s (%zu bytes into %zu): "
+	       "reference %d/%zu, got %d/%zu\n", page, what, in_len, cap,
+	       ret_ref, len_ref, ret_new, len_new);
+	return 1;
+}
+
+static int lzo_test_check(void)
+{
+	int n, i, failed = 0;
+
+	for (n = 0; n < nr_pages; n++) {
+		const u8 *c = cdata + n * cmax;
+		size_t clen = clens[n];
+		size_t len = PAGE_SIZE;
+
+		/* The intact stream must also give back the page */
+		if (lzo1x_decompress_safe(c, clen, out_new, &len) != LZO_E_OK ||
+		    len != PAGE_SIZE ||
+		    memcmp(out_new, pages + n * PAGE_SIZE, PAGE_SIZE)) {
+			printk(KERN_ERR "lzo_test: page %d does not "
+			       "round trip\n", n);
+			failed++;
+		}
+
+		failed += lzo_test_one(n, "intact", c, clen, PAGE_SIZE);
+		failed += lzo_test_one(n, "truncated", c,
+				       prandom32(&rnd) % clen, PAGE_SIZE);
+		failed += lzo_test_one(n, "short output", c, clen,
+				       prandom32(&rnd) % PAGE_SIZE);
+
+		memcpy(cbuf, c, clen);
+		for (i = prandom32(&rnd) % 4; i >= 0; i--)
+			cbuf[prandom32(&rnd) % clen] = prandom32(&rnd);
+		failed += lzo_test_one(n, "corrupted", cbuf, clen, PAGE_SIZE);
+	}
+
+	return failed;
+}
+
+static s64 lzo_test_time(int (*decompress)(const unsigned char *, size_t,
+					   unsigned char *, size_t *))
+{
+	ktime_t start = ktime_get();
+	int l, n;
+
+	for (l = 0; l < loops; l++) {
+		for (n = 0; n < nr_pages; n++) {
+			size_t len = PAGE_SIZE;
+
+			decompress(cdata + n * cmax, clens[n], out_new, &len);
+		}
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void lzo_test_bench(void)
+{
+	u64 bytes = (u64)loops * nr_pages * PAGE_SIZE;
+	s64 ns_ref, ns_new;
+
+	/* Warm up the caches first */
+	lzo_test_time(lzo1x_decompress_safe);
+
+	ns_ref = lzo_test_time(lzo1x_decompress_ref) ? : 1;
+	ns_new = lzo_test_time(lzo1x_decompress_safe) ? : 1;
+
+	printk(KERN_INFO "lzo_test: reference %llu MB/s, "
+	       "lzo1x_decompress_safe %llu MB/s\n",
+	       div64_u64(bytes * 1000, ns_ref),
+	       div64_u64(bytes * 1000, ns_new));
+}
+
+static void lzo_test_free(void)
+{
+	vfree(pages);
+	vfree(cdata);
+	kfree(clens);
+	kfree(cbuf);
+	kfree(out_ref);
+	kfree(out_new);
+}
+
+static int lzo_test_init(void)
+{
+	u64 ctotal = 0;
+	void *wrkmem;
+	int n, ret, failed;
+
+	if (nr_pages <= 0 || loops <= 0)
+		return -EINVAL;
+
+	prandom32_seed(&rnd, 0x4c5a4f);
+	cmax = lzo1x_worst_compress(PAGE_SIZE);
+	pages = vmalloc(nr_pages * PAGE_SIZE);
+	cdata = vmalloc(nr_pages * cmax);
+	clens = kcalloc(nr_pages, sizeof(*clens), GFP_KERNEL);
+	cbuf = kmalloc(cmax, GFP_KERNEL);
+	out_ref = kmalloc(PAGE_SIZE + GUARD_SIZE, GFP_KERNEL);
+	out_new = kmalloc(PAGE_SIZE + GUARD_SIZE, GFP_KERNEL);
+	wrkmem = kmalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!pages || !cdata || !clens || !cbuf || !out_ref || !out_new ||
+	    !wrkmem)
+		goto out;
+
+	if (corpus) {
+		ret = lzo_test_load();
+		if (ret) {
+			printk(KERN_ERR "lzo_test: cannot read pages from "
+			       "%s: %d\n", corpus, ret);
+			goto out;
+		}
+	} else {
+		for (n = 0; n < nr_pages; n++)
+			lzo_test_fill(pages + n * PAGE_SIZE);
+	}
+
+	for (n = 0; n < nr_pages; n++) {
+		lzo1x_1_compress(pages + n * PAGE_SIZE, PAGE_SIZE,
+				 cdata + n * cmax, &clens[n], wrkmem);
+		ctotal += clens[n];
+	}
+	printk(KERN_INFO "lzo_test: %d pages from %s, compressed to %llu%%\n",
+	       nr_pages, corpus ? corpus : "generator",
+	       div64_u64(ctotal * 100, (u64)nr_pages * PAGE_SIZE));
+
+	failed = lzo_test_check();
+	if (failed) {
+		printk(KERN_ERR "lzo_test: %d failures\n", failed);
+		ret = -EINVAL;
+		goto out;
+	}
+	printk(KERN_INFO "lzo_test: all tests passed\n");
+
+	lzo_test_bench();
+	ret = 0;
+out:
+	kfree(wrkmem);
+	lzo_test_free();
+	return ret;
+}
+
+static void lzo_test_exit(void)
+{
+}
+
+module_init(lzo_test_init);
+module_exit(lzo_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X decompressor self-test and benchmark");
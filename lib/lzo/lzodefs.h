@@ -38,6 +38,51 @@
 #define D_MASK		((1u << D_BITS) - 1)
 #define D_HIGH		((D_MASK >> 1) + 1)
 
+/*
+ * Copies of 4 (and 8) bytes at any alignment.  LZO_UNALIGNED_OK_4 is set
+ * where they are cheap enough to copy literal runs and matches a word at
+ * a time.  ARMv6 and later kernels have the hardware handle unaligned ldr
+ * and str (but not ldrd or ldm), which the compiler does not know about,
+ * so the loads and stores are issued by hand there.  The pre-boot
+ * decompressors (STATIC) run before that is set up and copy bytes.
+ */
+#if !defined(STATIC) && defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6
+#define LZO_UNALIGNED_OK_4
+
+static inline u32 lzo_get32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lzo_put32(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+
+#define COPY4(dst, src)	lzo_put32(dst, lzo_get32(src))
+#elif !defined(STATIC) && defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define LZO_UNALIGNED_OK_4
+#ifdef CONFIG_64BIT
+#define LZO_UNALIGNED_OK_8
+#endif
+#endif
+
+#ifndef COPY4
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#endif
+
+#ifdef LZO_UNALIGNED_OK_8
+#define COPY8(dst, src)	\
+		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
+#else
+#define COPY8(dst, src)	\
+		do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+#endif
+
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
@@ -10,42 +10,46 @@
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
- */
-union uu {
-	unsigned short us;
-	unsigned char b[2];
-};
-
-/* Endian independed version */
-static inline unsigned short
-get_unaligned16(const unsigned short *p)
+#ifdef INFLATE_FAST_WORDS
+#ifdef CONFIG_ARM
+/* The compiler does not know that these may be unaligned */
+static inline unsigned long load_word(const unsigned char *p)
 {
-	union uu  mm;
-	unsigned char *b = (unsigned char *)p;
+    unsigned long v;
 
-	mm.b[0] = b[0];
-	mm.b[1] = b[1];
-	return mm.us;
+    asm("ldr\t%0, %1" : "=r" (v) : "m" (*(const unsigned long *)p));
+    return v;
 }
 
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
-#  define UP_UNALIGNED(a) get_unaligned16((a)++)
+static inline void store_word(unsigned char *p, unsigned long v)
+{
+    asm("str\t%1, %0" : "=m" (*(unsigned long *)p) : "r" (v));
+}
+#else
+#  define load_word(p) (*(const unsigned long *)(p))
+#  define store_word(p, v) (*(unsigned long *)(p) = (v))
+#endif
+
+/* Make sure there are at least n (at most 15) bits in the bit buffer.  A
+   word refill tops it up to BITS_PER_LONG - 8 bits or more in one go.  The
+   byte it stops in the middle of is loaded again by the next refill, to
+   the same place, so the bits of hold above bits need not be zero. */
+#  define REFILL(n) \
+    do { \
+        if (bits < (n)) { \
+            hold |= load_word(in) << bits; \
+            in += (BITS_PER_LONG - 1 - bits) >> 3; \
+            bits |= BITS_PER_LONG - 8; \
+        } \
+    } while (0)
 #else
-#  define OFF 1
-#  define PUP(a) *++(a)
-#  define UP_UNALIGNED(a) get_unaligned16(++(a))
+#  define REFILL(n) \
+    do { \
+        while (bits < (n)) { \
+            hold += (unsigned long)(*in++) << bits; \
+            bits += 8; \
+        } \
+    } while (0)
 #endif
 
 /*
@@ -59,8 +63,8 @@ get_unaligned16(const unsigned short *p)
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_MIN_OUTPUT
         start >= strm->avail_out
         state->bits < 8
 
@@ -75,13 +79,16 @@ get_unaligned16(const unsigned short *p)
     - The maximum input bits used by a length/distance pair is 15 bits for the
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      Up to three literals, which is what one pass of the loop decodes
+      instead, take no more.  Therefore if strm->avail_in >= 6, then there is
+      enough input to avoid checking for available input while decoding.
+      A word refill may read a word past what it takes from the input.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      output space.  Word copies of a match may write up to a word less one
+      byte past its end, which the next match or literals overwrite.
 
     - @start:	inflate()'s starting value for strm->avail_out
  */
@@ -115,11 +122,11 @@ void inflate_fast(z_streamp strm, unsigned start)
 
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out - OFF;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_INPUT - 1));
+    out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_OUTPUT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -137,39 +144,46 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL(15);
         this = lcode[hold & lmask];
+        if (this.op == 0) {                     /* literals, up to three */
+            hold >>= this.bits;
+            bits -= this.bits;
+            *out++ = (unsigned char)(this.val);
+            REFILL(15);
+            this = lcode[hold & lmask];
+            if (this.op != 0)
+                continue;
+            hold >>= this.bits;
+            bits -= this.bits;
+            *out++ = (unsigned char)(this.val);
+            REFILL(15);
+            this = lcode[hold & lmask];
+            if (this.op != 0)
+                continue;
+            hold >>= this.bits;
+            bits -= this.bits;
+            *out++ = (unsigned char)(this.val);
+            continue;
+        }
       dolen:
         op = (unsigned)(this.bits);
         hold >>= op;
         bits -= op;
         op = (unsigned)(this.op);
         if (op == 0) {                          /* literal */
-            PUP(out) = (unsigned char)(this.val);
+            *out++ = (unsigned char)(this.val);
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(this.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
+                REFILL(op);
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
+            REFILL(15);
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -179,14 +193,7 @@ void inflate_fast(z_streamp strm, unsigned start)
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
+                REFILL(op);
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -205,103 +212,67 @@ void inflate_fast(z_streamp strm, unsigned start)
                         state->mode = BAD;
                         break;
                     }
-                    from = window - OFF;
                     if (write == 0) {           /* very common case */
-                        from += wsize - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
+                        from = window + wsize - op;
+                    }
+                    else if (write >= op) {     /* contiguous in window */
+                        from = window + write - op;
                     }
-                    else if (write < op) {      /* wrap around window */
-                        from += wsize + write - op;
+                    else {                      /* wrap around window */
+                        from = window + wsize + write - op;
                         op -= write;
                         if (op < len) {         /* some from end of window */
+                            memcpy(out, from, op);
+                            out += op;
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = window - OFF;
-                            if (write < len) {  /* some from start of window */
-                                op = write;
-                                len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
-                            }
-                        }
-                    }
-                    else {                      /* contiguous in window */
-                        from += write - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
+                            from = window;      /* then from start */
+                            op = write;
                         }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
+                    if (op >= len) {            /* all from window */
+                        memcpy(out, from, len);
+                        out += len;
+                        continue;
                     }
+                    memcpy(out, from, op);      /* some from window */
+                    out += op;
+                    len -= op;
                 }
-                else {
-		    unsigned short *sout;
-		    unsigned long loops;
+                from = out - dist;              /* copy direct from output */
+#ifdef INFLATE_FAST_WORDS
+                if (dist >= sizeof(unsigned long)) {
+                    unsigned char *copy_end = out + len;
 
-                    from = out - dist;          /* copy direct from output */
-		    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2) {
-			unsigned short *sfrom;
+                    do {
+                        store_word(out, load_word(from));
+                        out += sizeof(unsigned long);
+                        from += sizeof(unsigned long);
+                    } while (out < copy_end);
+                    out = copy_end;
+                    continue;
+                }
+                if (dist == 1) {                /* run of one byte */
+                    unsigned long pat = *from * (~0UL / 0xff);
+                    unsigned char *copy_end = out + len;
 
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
-			    PUP(sout) = PUP(sfrom);
-#else
-			    PUP(sout) = UP_UNALIGNED(sfrom);
+                    do {
+                        store_word(out, pat);
+                        out += sizeof(unsigned long);
+                    } while (out < copy_end);
+                    out = copy_end;
+                    continue;
+                }
 #endif
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
-
-			pat16 = *(sout-1+OFF);
-			if (dist == 1) {
-				union uu mm;
-				/* copy one char pattern to both bytes */
-				mm.us = pat16;
-				mm.b[0] = mm.b[1];
-				pat16 = mm.us;
-			}
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                while (len > 2) {
+                    *out++ = *from++;
+                    *out++ = *from++;
+                    *out++ = *from++;
+                    len -= 3;
+                }
+                if (len) {
+                    *out++ = *from++;
+                    if (len > 1)
+                        *out++ = *from++;
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -336,11 +307,14 @@ void inflate_fast(z_streamp strm, unsigned start)
     hold &= (1U << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_INPUT - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_INPUT - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+                                 (INFLATE_FAST_MIN_OUTPUT - 1) + (end - out) :
+                                 (INFLATE_FAST_MIN_OUTPUT - 1) - (out - end));
     state->hold = hold;
     state->bits = bits;
     return;
@@ -8,4 +8,28 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* Where unaligned words are cheap, inflate_fast() refills its bit buffer a
+   word at a time and copies matches a word at a time.  ARMv6 and later
+   kernels have the hardware fix up unaligned ldr and str.  The pre-boot
+   decompressors, which may decompress in place and can run before that is
+   set up, keep byte accesses, as does the reference copy of the old code
+   in the self-test, which defines INFLATE_FAST_BYTES. */
+#if !defined(STATIC) && !defined(INFLATE_FAST_BYTES) && \
+    defined(__LITTLE_ENDIAN) && \
+    ((defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6) || \
+     defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS))
+#  define INFLATE_FAST_WORDS
+#endif
+
+/* Input and output inflate_fast() needs to be called with: six bytes of
+   input for a length/distance pair and 258 bytes of output for the longest
+   match, plus a word past both that the word accesses may touch. */
+#ifdef INFLATE_FAST_WORDS
+#  define INFLATE_FAST_MIN_INPUT  (6 + sizeof(unsigned long))
+#  define INFLATE_FAST_MIN_OUTPUT (258 + sizeof(unsigned long) - 1)
+#else
+#  define INFLATE_FAST_MIN_INPUT  6
+#  define INFLATE_FAST_MIN_OUTPUT 258
+#endif
+
 void inflate_fast (z_streamp strm, unsigned start);
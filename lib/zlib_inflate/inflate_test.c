@@ -0,0 +1,449 @@
+/*
+ * zlib inflate self-test and benchmark module
+ *
+ * Compresses a buffer with zlib_deflate() at several levels, with and
+ * without the zlib header, and checks that zlib_inflate() behaves exactly
+ * as the byte at a time implementation it replaced, which is built into
+ * this module as zlib_inflate_ref(): same return code, same input and
+ * output left and same output after every call, with the input and output
+ * handed over in random pieces, for the intact streams as well as for
+ * truncated and corrupted ones, and nothing written past the output.
+ * Then times both decompressing the buffer the way squashfs does, in
+ * independent 128K blocks into page sized pieces, and the way initramfs
+ * unpacking does, as one stream into 32K pieces.
+ *
+ * The data is read from the file given as the corpus parameter, e.g. a
+ * squashfs or initramfs image unpacked, or made up when it is not given.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+
+int zlib_inflate_workspacesize_ref(void);
+int zlib_inflateInit2_ref(z_streamp strm, int windowBits);
+int zlib_inflate_ref(z_streamp strm, int flush);
+
+static char *corpus;
+module_param(corpus, charp, 0444);
+MODULE_PARM_DESC(corpus, "File to test with");
+
+static int size = 1 << 20;
+module_param(size, int, 0444);
+MODULE_PARM_DESC(size, "Maximum number of bytes to test with");
+
+static int rounds = 200;
+module_param(rounds, int, 0444);
+MODULE_PARM_DESC(rounds, "Number of random decompressions to compare");
+
+static int loops = 10;
+module_param(loops, int, 0444);
+MODULE_PARM_DESC(loops, "Number of passes over the data when timing");
+
+#define SQUASHFS_BLOCK	(128 * 1024)
+#define INITRAMFS_OUT	(32 * 1024)
+
+/* Room past the end of the output buffer to catch stray writes */
+#define GUARD_SIZE	64
+#define GUARD_BYTE	0xa5
+
+/* Calls of inflate() traced for the comparison, the rest is not */
+#define MAX_CALLS	256
+
+struct inflate_impl {
+	const char	*name;
+	int		(*init2)(z_streamp, int);
+	int		(*inflate)(z_streamp, int);
+	z_stream	strm;
+	u8		*out;
+	int		ret[MAX_CALLS];
+	unsigned int	avail_in[MAX_CALLS];
+	unsigned int	avail_out[MAX_CALLS];
+	int		calls;
+	size_t		out_len;
+};
+
+static struct inflate_impl impl_ref = {
+	.name		= "reference",
+	.init2		= zlib_inflateInit2_ref,
+	.inflate	= zlib_inflate_ref,
+};
+
+static struct inflate_impl impl_new = {
+	.name		= "zlib_inflate",
+	.init2		= zlib_inflateInit2,
+	.inflate	= zlib_inflate,
+};
+
+static u8 *data, *cdata;
+static unsigned int data_len, cdata_max;
+static struct rnd_state rnd;
+
+static int inflate_test_load(void)
+{
+	struct file *file;
+	int ret;
+
+	file = filp_open(corpus, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	ret = kernel_read(file, 0, data, size);
+	filp_close(file, NULL);
+
+	if (ret <= 0)
+		return ret ? ret : -ENODATA;
+	data_len = ret;
+	return 0;
+}
+
+/* Text, tables of small integers, runs and noise */
+static void inflate_test_fill(void)
+{
+	static const char * const words[] = {
+		"the ", "squashfs ", "inode ", "block ", "return ", "struct ",
+		"(void *)", "\n\t", "if (", ") {\n", "<div>", "0x0000",
+	};
+	u8 *p = data, *end = data + size;
+
+	while (p < end) {
+		unsigned int r = prandom32(&rnd);
+		unsigned int len = min_t(unsigned int, 16 + (r >> 8) % 1024,
+					 end - p);
+		unsigned int i, d;
+
+		switch (r % 6) {
+		case 0:
+		case 1:
+			for (i = 0; i < len; ) {
+				const char *w = words[prandom32(&rnd) %
+						      ARRAY_SIZE(words)];
+
+				while (*w && i < len)
+					p[i++] = *w++;
+			}
+			break;
+		case 2:
+			for (i = 0; i < len; i++)
+				p[i] = (i & 3) ? 0 : prandom32(&rnd) & 31;
+			break;
+		case 3:
+			memset(p, prandom32(&rnd) & 1 ? 0 : 0xff, len);
+			break;
+		case 4:		/* repeats at a short distance */
+			d = 1 + prandom32(&rnd) % 12;
+			for (i = 0; i < len; i++)
+				p[i] = i < d ? prandom32(&rnd) : p[i - d];
+			break;
+		default:
+			for (i = 0; i < len; i++)
+				p[i] = prandom32(&rnd);
+			break;
+		}
+		p += len;
+	}
+	data_len = size;
+}
+
+static int inflate_test_deflate(const u8 *src, unsigned int len, u8 *dst,
+				unsigned int max, int level, int wbits)
+{
+	z_stream strm;
+	int ret;
+
+	strm.workspace = vmalloc(zlib_deflate_workspacesize());
+	if (!strm.workspace)
+		return -ENOMEM;
+
+	ret = zlib_deflateInit2(&strm, level, Z_DEFLATED, wbits,
+				MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+	if (ret == Z_OK) {
+		strm.next_in = src;
+		strm.avail_in = len;
+		strm.next_out = dst;
+		strm.avail_out = max;
+		ret = zlib_deflate(&strm, Z_FINISH);
+		zlib_deflateEnd(&strm);
+	}
+	vfree(strm.workspace);
+
+	if (ret != Z_STREAM_END)
+		return -EINVAL;
+	return strm.total_out;
+}
+
+/*
+ * Inflate in into a buffer of cap bytes, handing over the input and the
+ * output in pieces of random size, drawn from a generator seeded with seed
+ */
+static void inflate_test_run(struct inflate_impl *im, const u8 *in,
+			     unsigned int in_len, unsigned int cap, int wbits,
+			     u64 seed)
+{
+	struct rnd_state pieces;
+	z_stream *strm = &im->strm;
+	unsigned int in_pos = 0, out_pos = 0;
+	int ret;
+
+	prandom32_seed(&pieces, seed);
+	memset(im->out, GUARD_BYTE, cap + GUARD_SIZE);
+	im->init2(strm, wbits);
+	im->calls = 0;
+
+	do {
+		unsigned int r = prandom32(&pieces);
+		unsigned int in_piece = r & 1 ? 1 + (r >> 8) % 64 :
+						1 + (r >> 8) % 65536;
+		unsigned int out_piece = r & 2 ? 1 + (r >> 16) % 512 :
+						 1 + (r >> 4) % 65536;
+
+		strm->next_in = in + in_pos;
+		strm->avail_in = min(in_piece, in_len - in_pos);
+		strm->next_out = im->out + out_pos;
+		strm->avail_out = min(out_piece, cap - out_pos);
+		in_piece = strm->avail_in;
+		out_piece = strm->avail_out;
+
+		ret = im->inflate(strm, Z_SYNC_FLUSH);
+
+		in_pos += in_piece - strm->avail_in;
+		out_pos += out_piece - strm->avail_out;
+		if (im->calls < MAX_CALLS) {
+			im->ret[im->calls] = ret;
+			im->avail_in[im->calls] = strm->avail_in;
+			im->avail_out[im->calls] = strm->avail_out;
+		}
+		im->calls++;
+	} while (ret == Z_OK);
+
+	im->out_len = out_pos;
+}
+
+static int inflate_test_one(const char *what, const u8 *in,
+			    unsigned int in_len, unsigned int cap, int wbits)
+{
+	u64 seed = prandom32(&rnd);
+	int calls, i;
+
+	inflate_test_run(&impl_ref, in, in_len, cap, wbits, seed);
+	inflate_test_run(&impl_new, in, in_len, cap, wbits, seed);
+
+	calls = min(impl_ref.calls, MAX_CALLS);
+	if (impl_ref.calls != impl_new.calls ||
+	    impl_ref.out_len != impl_new.out_len ||
+	    memcmp(impl_ref.ret, impl_new.ret, calls * sizeof(int)) ||
+	    memcmp(impl_ref.avail_in, impl_new.avail_in,
+		   calls * sizeof(unsigned int)) ||
+	    memcmp(impl_ref.avail_out, impl_new.avail_out,
+		   calls * sizeof(unsigned int)) ||
+	    memcmp(impl_ref.out, impl_new.out, impl_ref.out_len))
+		goto fail;
+	for (i = cap; i < cap + GUARD_SIZE; i++)
+		if (impl_new.out[i] != GUARD_BYTE)
+			goto fail;
+	return 0;
+
+fail:
+	printk(KERN_ERR "inflate_test: %s (%u bytes into %u, wbits %d): "
+	       "reference %d calls, %zu bytes, got %d calls, %zu bytes\n",
+	       what, in_len, cap, wbits, impl_ref.calls, impl_ref.out_len,
+	       impl_new.calls, impl_new.out_len);
+	return 1;
+}
+
+static int inflate_test_check(void)
+{
+	int round, failed = 0;
+
+	for (round = 0; round < rounds; round++) {
+		unsigned int len = 1 + prandom32(&rnd) % min(data_len, 1U << 18);
+		unsigned int off = prandom32(&rnd) % (data_len - len + 1);
+		int level = prandom32(&rnd) % 10;
+		int wbits = (prandom32(&rnd) & 1 ? 1 : -1) *
+			    (9 + prandom32(&rnd) % 7);
+		int clen, i;
+
+		clen = inflate_test_deflate(data + off, len, cdata, cdata_max,
+					    level, wbits);
+		if (clen < 0) {
+			printk(KERN_ERR "inflate_test: zlib_deflate failed\n");
+			return clen;
+		}
+		/* Decompress with the largest window, as the users do */
+		wbits = wbits > 0 ? MAX_WBITS : -MAX_WBITS;
+
+		if (inflate_test_one("intact", cdata, clen, len, wbits) ||
+		    memcmp(impl_new.out, data + off, len)) {
+			printk(KERN_ERR "inflate_test: round %d does not "
+			       "round trip\n", round);
+			failed++;
+		}
+		failed += inflate_test_one("truncated", cdata,
+					   prandom32(&rnd) % clen, len, wbits);
+		failed += inflate_test_one("short output", cdata, clen,
+					   prandom32(&rnd) % len, wbits);
+		for (i = prandom32(&rnd) % 4; i >= 0; i--)
+			cdata[prandom32(&rnd) % clen] ^=
+				1 << (prandom32(&rnd) % 8);
+		failed += inflate_test_one("corrupted", cdata, clen, len,
+					   wbits);
+	}
+
+	return failed;
+}
+
+/* Inflate blocks of cdata one after the other, out_piece bytes at a time */
+static s64 inflate_test_time(struct inflate_impl *im, const int *clens,
+			     int nr_blocks, unsigned int out_piece)
+{
+	ktime_t start = ktime_get();
+	z_stream *strm = &im->strm;
+	int l, b;
+
+	for (l = 0; l < loops; l++) {
+		const u8 *in = cdata;
+
+		for (b = 0; b < nr_blocks; b++) {
+			int ret;
+
+			im->init2(strm, MAX_WBITS);
+			strm->next_in = in;
+			strm->avail_in = clens[b];
+			do {
+				strm->next_out = im->out;
+				strm->avail_out = out_piece;
+				ret = im->inflate(strm, Z_SYNC_FLUSH);
+			} while (ret == Z_OK);
+			in += clens[b];
+		}
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start)) ? : 1;
+}
+
+static int inflate_test_bench(const char *what, unsigned int block,
+			      unsigned int out_piece)
+{
+	int nr_blocks = DIV_ROUND_UP(data_len, block);
+	u64 bytes = (u64)loops * data_len;
+	unsigned int off, clen_total = 0;
+	s64 ns_ref, ns_new;
+	int *clens, b;
+
+	clens = kmalloc(nr_blocks * sizeof(*clens), GFP_KERNEL);
+	if (!clens)
+		return -ENOMEM;
+
+	for (b = 0, off = 0; b < nr_blocks; b++, off += block) {
+		clens[b] = inflate_test_deflate(data + off,
+						min(block, data_len - off),
+						cdata + clen_total,
+						cdata_max - clen_total, 6,
+						MAX_WBITS);
+		if (clens[b] < 0) {
+			kfree(clens);
+			return clens[b];
+		}
+		clen_total += clens[b];
+	}
+
+	/* Warm up the caches first */
+	inflate_test_time(&impl_new, clens, nr_blocks, out_piece);
+
+	ns_ref = inflate_test_time(&impl_ref, clens, nr_blocks, out_piece);
+	ns_new = inflate_test_time(&impl_new, clens, nr_blocks, out_piece);
+
+	printk(KERN_INFO "inflate_test: %s: reference %llu MB/s, "
+	       "zlib_inflate %llu MB/s\n", what,
+	       div64_u64(bytes * 1000, ns_ref),
+	       div64_u64(bytes * 1000, ns_new));
+
+	kfree(clens);
+	return 0;
+}
+
+static void inflate_test_free(void)
+{
+	vfree(data);
+	vfree(cdata);
+	vfree(impl_ref.strm.workspace);
+	vfree(impl_new.strm.workspace);
+	vfree(impl_ref.out);
+	vfree(impl_new.out);
+}
+
+static int inflate_test_init(void)
+{
+	unsigned int out_size;
+	int ret, failed;
+
+	if (size <= 0 || rounds < 0 || loops <= 0)
+		return -EINVAL;
+
+	prandom32_seed(&rnd, 0x7a6c6962);
+	/* Leave room for stored blocks and the headers */
+	cdata_max = size + size / 64 + 1024;
+	data = vmalloc(size);
+	cdata = vmalloc(cdata_max);
+	impl_ref.strm.workspace = vmalloc(zlib_inflate_workspacesize_ref());
+	impl_new.strm.workspace = vmalloc(zlib_inflate_workspacesize());
+	/* The timing decompresses 32K at a time whatever the size */
+	out_size = max_t(unsigned int, size, INITRAMFS_OUT) + GUARD_SIZE;
+	impl_ref.out = vmalloc(out_size);
+	impl_new.out = vmalloc(out_size);
+	ret = -ENOMEM;
+	if (!data || !cdata || !impl_ref.strm.workspace ||
+	    !impl_new.strm.workspace || !impl_ref.out || !impl_new.out)
+		goto out;
+
+	if (corpus) {
+		ret = inflate_test_load();
+		if (ret) {
+			printk(KERN_ERR "inflate_test: cannot read %s: %d\n",
+			       corpus, ret);
+			goto out;
+		}
+	} else {
+		inflate_test_fill();
+	}
+	printk(KERN_INFO "inflate_test: %u bytes from %s\n", data_len,
+	       corpus ? corpus : "generator");
+
+	failed = inflate_test_check();
+	if (failed) {
+		if (failed > 0)
+			printk(KERN_ERR "inflate_test: %d failures\n", failed);
+		ret = failed > 0 ? -EINVAL : failed;
+		goto out;
+	}
+	printk(KERN_INFO "inflate_test: all tests passed\n");
+
+	ret = inflate_test_bench("squashfs", SQUASHFS_BLOCK, PAGE_SIZE);
+	if (!ret)
+		ret = inflate_test_bench("initramfs", data_len, INITRAMFS_OUT);
+out:
+	inflate_test_free();
+	return ret;
+}
+
+static void inflate_test_exit(void)
+{
+}
+
+module_init(inflate_test_init);
+module_exit(inflate_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zlib inflate self-test and benchmark");
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 /*
@@ -436,6 +438,22 @@ static unsigned long compact_zone_order(struct zone *zone,
 
 int sysctl_extfrag_threshold = 500;
 
+/**
+ * compaction_suitable - Would compaction help an allocation of this order
+ * @zone: The zone the allocation would be served from
+ * @order: The order of the allocation
+ *
+ * Returns true when an allocation of @order failing on @zone would be due
+ * to external fragmentation rather than to a lack of free memory.
+ */
+bool compaction_suitable(struct zone *zone, int order)
+{
+	int fragindex = fragmentation_index(zone, order);
+
+	/* -1000 means that it would only fail on the watermarks */
+	return fragindex < 0 || fragindex > sysctl_extfrag_threshold;
+}
+
 /**
  * try_to_compact_pages - Direct compact to satisfy a high-order allocation
  * @zonelist: The zonelist used for the current allocation
@@ -513,6 +531,180 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 }
 
 
+/*
+ * kcompactd keeps orders 2 to 4, which drivers allocate without being
+ * prepared for failures, available by compacting a zone as soon as more
+ * than sysctl_extfrag_proactive_threshold thousandths of its free memory
+ * are in smaller blocks.  It also compacts for kswapd, which wakes it
+ * instead of reclaiming lumps of pages for high-order allocations.
+ */
+#define KCOMPACTD_MIN_ORDER	2
+#define KCOMPACTD_MAX_ORDER	4
+#define KCOMPACTD_INTERVAL	(5 * HZ)
+
+int sysctl_extfrag_proactive_threshold = 800;
+
+/* Like defer_compaction() and compaction_deferred(), for kcompactd */
+static void defer_proactive_compaction(struct zone *zone)
+{
+	zone->proactive_considered = 0;
+	zone->proactive_defer_shift++;
+
+	if (zone->proactive_defer_shift > COMPACT_MAX_DEFER_SHIFT)
+		zone->proactive_defer_shift = COMPACT_MAX_DEFER_SHIFT;
+}
+
+static bool proactive_compaction_deferred(struct zone *zone)
+{
+	unsigned long defer_limit = 1UL << zone->proactive_defer_shift;
+
+	if (++zone->proactive_considered > defer_limit)
+		zone->proactive_considered = defer_limit;
+
+	return zone->proactive_considered < defer_limit;
+}
+
+static bool zone_fragmented(struct zone *zone)
+{
+	int order;
+
+	for (order = KCOMPACTD_MIN_ORDER; order <= KCOMPACTD_MAX_ORDER; order++)
+		if (unusable_index(zone, order) >
+					sysctl_extfrag_proactive_threshold)
+			return true;
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+	bool drained = false;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order ? order : -1,
+			.migratetype = allocflags_to_migratetype(GFP_KERNEL),
+			.zone = zone,
+		};
+
+		if (!populated_zone(zone))
+			continue;
+
+		/* Migration needs free pages to copy to */
+		if (!zone_watermark_ok(zone, 0, low_wmark_pages(zone) +
+				       (2UL << KCOMPACTD_MAX_ORDER), 0, 0))
+			continue;
+
+		if (order) {
+			if (zone_watermark_ok(zone, order,
+					      low_wmark_pages(zone), 0, 0) ||
+			    !compaction_suitable(zone, order))
+				continue;
+		} else {
+			if (!sysctl_extfrag_proactive_threshold ||
+			    !zone_fragmented(zone) ||
+			    proactive_compaction_deferred(zone))
+				continue;
+		}
+
+		if (!drained) {
+			lru_add_drain_all();
+			drained = true;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		count_vm_event(KCOMPACTD_RUN);
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		/*
+		 * Record the outcome for kswapd as direct compaction does:
+		 * it reclaims for high orders itself while this is failing.
+		 * Back off from zones which compaction cannot help.
+		 */
+		if (order) {
+			if (zone_watermark_ok(zone, order,
+					      low_wmark_pages(zone), 0, 0))
+				zone->compact_defer_shift = 0;
+			else
+				defer_compaction(zone);
+		} else {
+			if (zone_fragmented(zone))
+				defer_proactive_compaction(zone);
+			else
+				zone->proactive_defer_shift = 0;
+		}
+
+		if (kthread_should_stop())
+			break;
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		int order;
+
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order ||
+				kthread_should_stop(), KCOMPACTD_INTERVAL);
+
+		order = pgdat->kcompactd_max_order;
+		pgdat->kcompactd_max_order = 0;
+		kcompactd_do_work(pgdat, order);
+	}
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - Ask kcompactd to compact for a high-order allocation
+ * @pgdat: The node to compact
+ * @order: The order of the allocation
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!pgdat->kcompactd || order <= 0)
+		return;
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat->kcompactd = kthread_run(kcompactd, pgdat,
+					       "kcompactd%d", nid);
+		if (IS_ERR(pgdat->kcompactd)) {
+			printk(KERN_ERR "Failed to start kcompactd on node %d\n",
+			       nid);
+			pgdat->kcompactd = NULL;
+		}
+	}
+	return 0;
+}
+module_init(kcompactd_init)
+
 /* Compact all zones within a node */
 static int compact_node(int nid)
 {
@@ -1626,8 +1626,85 @@ page_not_uptodate:
 }
 EXPORT_SYMBOL(filemap_fault);
 
+/*
+ * Map one page found by filemap_map_pages(), if it is uptodate, not
+ * being read ahead, and still within the file.  Returns 0 if the page
+ * was not mapped, and the caller must drop its reference.
+ */
+static int filemap_map_page(struct vm_area_struct *vma, struct vm_fault *vmf,
+			    struct page *page)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	unsigned long addr;
+	pgoff_t size;
+	pte_t *pte;
+
+	if (!PageUptodate(page) || PageReadahead(page) ||
+	    PageHWPoison(page))
+		return 0;
+	if (!trylock_page(page))
+		return 0;
+
+	/* Truncated or invalidated meanwhile? */
+	if (page->mapping != mapping || !PageUptodate(page))
+		goto unlock;
+	size = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1)
+						>> PAGE_CACHE_SHIFT;
+	if (page->index >= size)
+		goto unlock;
+
+	pte = vmf->pte + page->index - vmf->pgoff;
+	if (!pte_none(*pte))
+		goto unlock;
+
+	addr = (unsigned long)vmf->virtual_address +
+				((page->index - vmf->pgoff) << PAGE_SHIFT);
+	do_set_pte(vma, addr, page, pte);
+	unlock_page(page);
+	return 1;
+unlock:
+	unlock_page(page);
+	return 0;
+}
+
+/**
+ * filemap_map_pages - map the cached pages around a read fault
+ * @vma:	vma in which the fault was taken
+ * @vmf:	range to map, ptes to fill in
+ *
+ * filemap_map_pages() is called with the pte lock held, before ->fault
+ * is called for a read fault.  It maps the pages of the range which are
+ * already in the page cache and uptodate; it neither blocks nor starts
+ * any I/O, and leaves the pages under readahead to filemap_fault() so
+ * that the async readahead they trigger still happens.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	struct page *pages[PAGEVEC_SIZE];
+	pgoff_t index = vmf->pgoff;
+	unsigned int i, nr;
+
+	while (index <= vmf->max_pgoff) {
+		nr = find_get_pages(mapping, index,
+				min_t(pgoff_t, PAGEVEC_SIZE,
+				      vmf->max_pgoff - index + 1), pages);
+		if (!nr)
+			break;
+		index = pages[nr - 1]->index + 1;
+
+		for (i = 0; i < nr; i++) {
+			if (pages[i]->index > vmf->max_pgoff ||
+			    !filemap_map_page(vma, vmf, pages[i]))
+				page_cache_release(pages[i]);
+		}
+	}
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
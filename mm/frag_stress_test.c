@@ -0,0 +1,163 @@
+/*
+ * High-order allocation stress test module
+ *
+ * Every interval_ms, tries to allocate nr_allocs blocks of each order
+ * from order_min to order_max without retrying or reclaiming hard,
+ * holds on to all of them until the end of the round and reports how
+ * many succeeded and how long the allocations took.  Run it while the
+ * system is in use to follow how fragmentation evolves over time, with
+ * and without background compaction.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/delay.h>
+#include <linux/gfp.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+
+static int order_min = 2;
+module_param(order_min, int, 0444);
+MODULE_PARM_DESC(order_min, "Lowest order allocated");
+
+static int order_max = 4;
+module_param(order_max, int, 0444);
+MODULE_PARM_DESC(order_max, "Highest order allocated");
+
+static int nr_allocs = 32;
+module_param(nr_allocs, int, 0444);
+MODULE_PARM_DESC(nr_allocs, "Allocations per order and round");
+
+static int rounds = 60;
+module_param(rounds, int, 0444);
+MODULE_PARM_DESC(rounds, "Number of rounds, 0 to run until unloaded");
+
+static int interval_ms = 1000;
+module_param(interval_ms, int, 0444);
+MODULE_PARM_DESC(interval_ms, "Delay between rounds (ms)");
+
+struct frag_order_stats {
+	unsigned long	attempts;
+	unsigned long	successes;
+	s64		total_ns;
+	s64		max_ns;
+};
+
+static struct task_struct *frag_thread;
+static struct page **frag_pages;
+static struct frag_order_stats frag_stats[MAX_ORDER];
+
+static void frag_round(int round)
+{
+	int order, i, nr = 0;
+
+	for (order = order_min; order <= order_max; order++) {
+		struct frag_order_stats *st = &frag_stats[order];
+		s64 total = 0, max = 0;
+		int ok = 0;
+
+		for (i = 0; i < nr_allocs; i++) {
+			struct page *page;
+			ktime_t start = ktime_get();
+			s64 lat;
+
+			page = alloc_pages(GFP_KERNEL | __GFP_NORETRY |
+					   __GFP_NOWARN, order);
+			lat = ktime_to_ns(ktime_sub(ktime_get(), start));
+			total += lat;
+			max = max(max, lat);
+			if (page) {
+				set_page_private(page, order);
+				frag_pages[nr++] = page;
+				ok++;
+			}
+		}
+
+		st->attempts += nr_allocs;
+		st->successes += ok;
+		st->total_ns += total;
+		st->max_ns = max(st->max_ns, max);
+
+		printk(KERN_INFO "frag_stress: round %d order %d: %d/%d "
+		       "allocated, avg %lld max %lld us\n",
+		       round, order, ok, nr_allocs,
+		       (long long)div_s64(div_s64(total, nr_allocs),
+					  NSEC_PER_USEC),
+		       (long long)div_s64(max, NSEC_PER_USEC));
+	}
+
+	while (nr--)
+		__free_pages(frag_pages[nr], page_private(frag_pages[nr]));
+}
+
+static int frag_stress_thread(void *unused)
+{
+	int round;
+
+	for (round = 1; !rounds || round <= rounds; round++) {
+		frag_round(round);
+		if (msleep_interruptible(interval_ms) || kthread_should_stop())
+			break;
+	}
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static int frag_stress_test_init(void)
+{
+	if (order_min < 1 || order_max >= MAX_ORDER || order_min > order_max ||
+	    nr_allocs <= 0 || rounds < 0 || interval_ms < 0)
+		return -EINVAL;
+
+	frag_pages = kcalloc(nr_allocs * (order_max - order_min + 1),
+			     sizeof(*frag_pages), GFP_KERNEL);
+	if (!frag_pages)
+		return -ENOMEM;
+
+	frag_thread = kthread_run(frag_stress_thread, NULL, "frag_stress");
+	if (IS_ERR(frag_thread)) {
+		kfree(frag_pages);
+		return PTR_ERR(frag_thread);
+	}
+	return 0;
+}
+
+static void frag_stress_test_exit(void)
+{
+	int order;
+
+	kthread_stop(frag_thread);
+	kfree(frag_pages);
+
+	for (order = order_min; order <= order_max; order++) {
+		struct frag_order_stats *st = &frag_stats[order];
+
+		if (!st->attempts)
+			continue;
+		printk(KERN_INFO "frag_stress: order %d: %lu/%lu allocated, "
+		       "avg %lld max %lld us\n",
+		       order, st->successes, st->attempts,
+		       (long long)div_s64(div_s64(st->total_ns, st->attempts),
+					  NSEC_PER_USEC),
+		       (long long)div_s64(st->max_ns, NSEC_PER_USEC));
+	}
+}
+
+module_init(frag_stress_test_init);
+module_exit(frag_stress_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("High-order allocation stress test");
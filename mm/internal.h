@@ -67,6 +67,9 @@ static inline unsigned long page_order(struct page *page)
 }
 
 #ifdef CONFIG_MMU
+extern void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		       struct page *page, pte_t *pte);
+
 extern long mlock_vma_pages_range(struct vm_area_struct *vma,
 			unsigned long start, unsigned long end);
 extern void munlock_vma_pages_range(struct vm_area_struct *vma,
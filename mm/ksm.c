@@ -33,6 +33,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/math64.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -126,6 +127,8 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @skip_until: low bits of the full scan from which to look at the page again
+ * @volatility: number of consecutive scans the checksum changed on
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -136,6 +139,8 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	unsigned short skip_until;	/* when volatile */
+	unsigned short volatility;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -185,6 +190,33 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * ksmd sleeps 1 << ksm_sleep_shift times longer while full scans merge
+ * little, up to 1 << ksm_max_sleep_shift times.
+ */
+static unsigned int ksm_sleep_shift;
+static unsigned int ksm_max_sleep_shift = 3;
+
+/* Pages scanned and merged in the current full scan */
+static unsigned long ksm_scan_scanned;
+static unsigned long ksm_scan_merged;
+
+/* A page whose checksum keeps changing is skipped for up to 2^shift scans */
+static unsigned int ksm_volatile_skip_shift = 4;
+
+/* The number of page scans skipped because the page was volatile */
+static unsigned long ksm_pages_skipped;
+
+/* The number of pages replaced by the zero page */
+static unsigned long ksm_zero_pages_merged;
+
+/* The number of pages merged, and the cpu time ksmd took doing so */
+static unsigned long ksm_pages_merged;
+static u64 ksm_cpu_time;
+
+/* Checksum of a page full of zeroes */
+static u32 zero_checksum __read_mostly;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -713,6 +745,19 @@ static inline int pages_identical(struct page *page1, struct page *page2)
 	return !memcmp_pages(page1, page2);
 }
 
+static int page_is_zero(struct page *page)
+{
+	unsigned long *addr = kmap_atomic(page, KM_USER0);
+	int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(*addr); i++) {
+		if (addr[i])
+			break;
+	}
+	kunmap_atomic(addr, KM_USER0);
+	return i == PAGE_SIZE / sizeof(*addr);
+}
+
 static int write_protect_page(struct vm_area_struct *vma, struct page *page,
 			      pte_t *orig_pte)
 {
@@ -770,7 +815,7 @@ out:
  * replace_page - replace page in vma by new ksm page
  * @vma:      vma that holds the pte pointing to page
  * @page:     the page we are replacing by kpage
- * @kpage:    the ksm page we replace page by
+ * @kpage:    the ksm page we replace page by, or NULL for the zero page
  * @orig_pte: the original value of the pte
  *
  * Returns 0 on success, -EFAULT on failure.
@@ -782,7 +827,7 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 	pgd_t *pgd;
 	pud_t *pud;
 	pmd_t *pmd;
-	pte_t *ptep;
+	pte_t *ptep, newpte;
 	spinlock_t *ptl;
 	unsigned long addr;
 	int err = -EFAULT;
@@ -809,12 +854,20 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 		goto out;
 	}
 
-	get_page(kpage);
-	page_add_anon_rmap(kpage, vma, addr);
+	if (kpage) {
+		get_page(kpage);
+		page_add_anon_rmap(kpage, vma, addr);
+		newpte = mk_pte(kpage, vma->vm_page_prot);
+	} else {
+		/* mapped as do_anonymous_page() maps it on a read fault */
+		newpte = pte_mkspecial(pfn_pte(page_to_pfn(ZERO_PAGE(addr)),
+					       vma->vm_page_prot));
+		dec_mm_counter(mm, MM_ANONPAGES);
+	}
 
 	flush_cache_page(vma, addr, pte_pfn(*ptep));
 	ptep_clear_flush(vma, addr, ptep);
-	set_pte_at_notify(mm, addr, ptep, mk_pte(kpage, vma->vm_page_prot));
+	set_pte_at_notify(mm, addr, ptep, newpte);
 
 	page_remove_rmap(page);
 	put_page(page);
@@ -923,6 +976,42 @@ out:
 	return err;
 }
 
+/*
+ * try_to_merge_zero_page - map the zero page in place of a page full of
+ * zeroes, without going through the stable tree.
+ *
+ * This function returns 0 if the page was replaced, -EFAULT otherwise.
+ */
+static int try_to_merge_zero_page(struct rmap_item *rmap_item,
+				  struct page *page)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	struct vm_area_struct *vma;
+	pte_t orig_pte = __pte(0);
+	int err = -EFAULT;
+
+	down_read(&mm->mmap_sem);
+	if (ksm_test_exit(mm))
+		goto out;
+	vma = find_vma(mm, rmap_item->address);
+	if (!vma || vma->vm_start > rmap_item->address)
+		goto out;
+	if ((vma->vm_flags & (VM_MERGEABLE | VM_LOCKED)) != VM_MERGEABLE)
+		goto out;
+	if (!PageAnon(page) || !trylock_page(page))
+		goto out;
+
+	/* It may have been written to before we write protected it */
+	if (write_protect_page(vma, page, &orig_pte) == 0 &&
+	    page_is_zero(page))
+		err = replace_page(vma, page, NULL, orig_pte);
+
+	unlock_page(page);
+out:
+	up_read(&mm->mmap_sem);
+	return err;
+}
+
 /*
  * try_to_merge_two_pages - take two identical pages and prepare them
  * to be merged into one page.
@@ -1148,6 +1237,50 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
  */
+static inline void ksm_merged(unsigned long nr)
+{
+	ksm_pages_merged += nr;
+	ksm_scan_merged += nr;
+}
+
+/*
+ * checksum_changed - record the checksum of the page of rmap_item
+ *
+ * If the hash value of the page has changed from the last time we
+ * calculated it, this page is changing frequently: therefore we don't
+ * want to insert it in the unstable tree, and we don't want to waste our
+ * time searching for something identical to it there.  If it keeps
+ * changing, don't even look at it for the next 1, 2, 4... full scans.
+ *
+ * skip_until only holds the low bits of the scan number: it is rewritten
+ * on every change and only looked at while the page is volatile, so it is
+ * never more than 1 << ksm_volatile_skip_shift scans ahead when it is.
+ */
+static int checksum_changed(struct rmap_item *rmap_item, u32 checksum)
+{
+	unsigned int shift;
+
+	if (rmap_item->oldchecksum == checksum) {
+		rmap_item->volatility = 0;
+		return 0;
+	}
+
+	rmap_item->oldchecksum = checksum;
+	shift = min_t(unsigned int, rmap_item->volatility,
+		      ksm_volatile_skip_shift);
+	rmap_item->skip_until = ksm_scan.seqnr + (shift ? 1U << shift : 0);
+	if (rmap_item->volatility < ksm_volatile_skip_shift)
+		rmap_item->volatility++;
+	return 1;
+}
+
+static inline int rmap_item_skipped(struct rmap_item *rmap_item)
+{
+	return rmap_item->volatility &&
+	       (short)(rmap_item->skip_until -
+		       (unsigned short)ksm_scan.seqnr) > 0;
+}
+
 static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 {
 	struct rmap_item *tree_rmap_item;
@@ -1159,6 +1292,19 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 
 	remove_rmap_item_from_tree(rmap_item);
 
+	/*
+	 * A page full of zeroes which stayed so since the last scan is
+	 * replaced by the zero page, keeping it out of both trees.
+	 */
+	if (page_is_zero(page)) {
+		if (!checksum_changed(rmap_item, zero_checksum) &&
+		    !try_to_merge_zero_page(rmap_item, page)) {
+			ksm_zero_pages_merged++;
+			ksm_merged(1);
+		}
+		return;
+	}
+
 	/* We first start with searching the page inside the stable tree */
 	kpage = stable_tree_search(page);
 	if (kpage) {
@@ -1171,22 +1317,15 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			ksm_merged(1);
 		}
 		put_page(kpage);
 		return;
 	}
 
-	/*
-	 * If the hash value of the page has changed from the last time
-	 * we calculated it, this page is changing frequently: therefore we
-	 * don't want to insert it in the unstable tree, and we don't want
-	 * to waste our time searching for something identical to it there.
-	 */
 	checksum = calc_checksum(page);
-	if (rmap_item->oldchecksum != checksum) {
-		rmap_item->oldchecksum = checksum;
+	if (checksum_changed(rmap_item, checksum))
 		return;
-	}
 
 	tree_rmap_item =
 		unstable_tree_search_insert(rmap_item, page, &tree_page);
@@ -1207,6 +1346,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				ksm_merged(1);
 			}
 			unlock_page(kpage);
 
@@ -1363,6 +1503,18 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+
+	/*
+	 * Back off while full scans merge less than 1% of the pages they
+	 * look at, and come back as soon as they merge more.
+	 */
+	if (ksm_scan_merged * 100 < ksm_scan_scanned) {
+		if (ksm_sleep_shift < ksm_max_sleep_shift)
+			ksm_sleep_shift++;
+	} else if (ksm_sleep_shift)
+		ksm_sleep_shift--;
+	ksm_scan_scanned = 0;
+	ksm_scan_merged = 0;
 	return NULL;
 }
 
@@ -1380,8 +1532,15 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
+		ksm_scan_scanned++;
+		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
+			if (rmap_item_skipped(rmap_item)) {
+				/* Not left behind in an old unstable tree */
+				remove_rmap_item_from_tree(rmap_item);
+				ksm_pages_skipped++;
+			} else
+				cmp_and_merge_page(page, rmap_item);
+		}
 		put_page(page);
 	}
 }
@@ -1393,17 +1552,23 @@ static int ksmd_should_run(void)
 
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned long long runtime;
+
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			runtime = task_sched_runtime(current);
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_cpu_time += task_sched_runtime(current) - runtime;
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
 			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksm_thread_sleep_millisecs <<
+				    min(ksm_sleep_shift, ksm_max_sleep_shift)));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1467,6 +1632,9 @@ int __ksm_enter(struct mm_struct *mm)
 	/* Check ksm_run too?  Would need tighter locking */
 	needs_wakeup = list_empty(&ksm_mm_head.mm_list);
 
+	/* Scan the new area at full speed */
+	ksm_sleep_shift = 0;
+
 	spin_lock(&ksm_mmlist_lock);
 	insert_to_mm_slots_hash(mm, mm_slot);
 	/*
@@ -1919,6 +2087,84 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_skipped_volatile_show(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped_volatile);
+
+static ssize_t zero_pages_merged_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_zero_pages_merged);
+}
+KSM_ATTR_RO(zero_pages_merged);
+
+static ssize_t merged_per_cpu_sec_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	u64 merged, cpu_time, rate = 0;
+
+	/* ksmd updates the 64 bit ksm_cpu_time under ksm_thread_mutex */
+	mutex_lock(&ksm_thread_mutex);
+	merged = ksm_pages_merged;
+	cpu_time = ksm_cpu_time;
+	mutex_unlock(&ksm_thread_mutex);
+
+	if (cpu_time)
+		rate = div64_u64(merged * NSEC_PER_SEC, cpu_time);
+	return sprintf(buf, "%llu\n", (unsigned long long)rate);
+}
+KSM_ATTR_RO(merged_per_cpu_sec);
+
+static ssize_t volatile_skip_shift_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_volatile_skip_shift);
+}
+
+static ssize_t volatile_skip_shift_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long shift;
+	int err;
+
+	err = strict_strtoul(buf, 10, &shift);
+	if (err || shift > 10)
+		return -EINVAL;
+
+	ksm_volatile_skip_shift = shift;
+
+	return count;
+}
+KSM_ATTR(volatile_skip_shift);
+
+static ssize_t max_sleep_shift_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_max_sleep_shift);
+}
+
+static ssize_t max_sleep_shift_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long shift;
+	int err;
+
+	err = strict_strtoul(buf, 10, &shift);
+	if (err || shift > 10)
+		return -EINVAL;
+
+	ksm_max_sleep_shift = shift;
+
+	return count;
+}
+KSM_ATTR(max_sleep_shift);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1928,6 +2174,11 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_skipped_volatile_attr.attr,
+	&zero_pages_merged_attr.attr,
+	&merged_per_cpu_sec_attr.attr,
+	&volatile_skip_shift_attr.attr,
+	&max_sleep_shift_attr.attr,
 	NULL,
 };
 
@@ -1950,6 +2201,8 @@ static int __init ksm_init(void)
 	if (err)
 		goto out_free1;
 
+	zero_checksum = calc_checksum(ZERO_PAGE(0));
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
@@ -1014,9 +1014,9 @@ unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 		if (scan >= nr_to_scan)
 			break;
 
-		page = pc->page;
 		if (unlikely(!PageCgroupUsed(pc)))
 			continue;
+		page = lookup_cgroup_page(pc);
 		if (unlikely(!PageLRU(page)))
 			continue;
 
@@ -1530,6 +1530,28 @@ static void refill_stock(struct mem_cgroup *mem, int val)
 	put_cpu_var(memcg_stock);
 }
 
+/*
+ * Give back one page worth of charge to the local stock instead of the
+ * res_counter, if the stock caches @mem and isn't full.  The charge can
+ * only carry memsw with it when memsw was charged along with res.
+ */
+static bool uncharge_to_stock(struct mem_cgroup *mem, bool uncharge_memsw)
+{
+	struct memcg_stock_pcp *stock;
+	bool ret = false;
+
+	if (uncharge_memsw != do_swap_account)
+		return false;
+
+	stock = &get_cpu_var(memcg_stock);
+	if (stock->cached == mem && stock->charge < CHARGE_SIZE) {
+		stock->charge += PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
 /*
  * Tries to drain stocked charges in other cpus. This function is asynchronous
  * and just put a work per cpu for draining localy on each cpu. Caller can
@@ -1857,7 +1879,7 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 	 * Insert ancestor (and ancestor's ancestors), to softlimit RB-tree.
 	 * if they exceeds softlimit.
 	 */
-	memcg_check_events(mem, pc->page);
+	memcg_check_events(mem, lookup_cgroup_page(pc));
 }
 
 /**
@@ -1881,7 +1903,7 @@ static void __mem_cgroup_move_account(struct page_cgroup *pc,
 	struct mem_cgroup *from, struct mem_cgroup *to, bool uncharge)
 {
 	VM_BUG_ON(from == to);
-	VM_BUG_ON(PageLRU(pc->page));
+	VM_BUG_ON(PageLRU(lookup_cgroup_page(pc)));
 	VM_BUG_ON(!PageCgroupLocked(pc));
 	VM_BUG_ON(!PageCgroupUsed(pc));
 	VM_BUG_ON(pc->mem_cgroup != from);
@@ -1927,8 +1949,8 @@ static int mem_cgroup_move_account(struct page_cgroup *pc,
 	/*
 	 * check events
 	 */
-	memcg_check_events(to, pc->page);
-	memcg_check_events(from, pc->page);
+	memcg_check_events(to, lookup_cgroup_page(pc));
+	memcg_check_events(from, lookup_cgroup_page(pc));
 	return ret;
 }
 
@@ -1940,7 +1962,7 @@ static int mem_cgroup_move_parent(struct page_cgroup *pc,
 				  struct mem_cgroup *child,
 				  gfp_t gfp_mask)
 {
-	struct page *page = pc->page;
+	struct page *page = lookup_cgroup_page(pc);
 	struct cgroup *cg = child->css.cgroup;
 	struct cgroup *pcg = cg->parent;
 	struct mem_cgroup *parent;
@@ -2213,8 +2235,18 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 	 * because we want to do uncharge as soon as possible.
 	 */
 
-	if (!batch->do_batch || test_thread_flag(TIF_MEMDIE))
+	if (test_thread_flag(TIF_MEMDIE))
 		goto direct_uncharge;
+	/*
+	 * A page freed on its own, by reclaim or by the page allocator's
+	 * callers, is likely charged to the group this cpu last charged
+	 * to: let the next charge use it without touching res_counter.
+	 */
+	if (!batch->do_batch) {
+		if (uncharge_to_stock(mem, uncharge_memsw))
+			return;
+		goto direct_uncharge;
+	}
 
 	/*
 	 * In typical case, batch->memcg == mem. This means we can
@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -2706,11 +2707,11 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		page = swapin_readahead_vma(entry, GFP_HIGHUSER_MOVABLE,
+					    vma, address, pmd);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -2950,6 +2951,104 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/*
+ * Map a page cache page read-only at @address, on behalf of a read
+ * fault.  The caller holds the pte lock and a reference on the page,
+ * which the mapping takes over.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Number of pages around a read fault on a file mapping which are mapped
+ * at once if they are already in the page cache, saving a minor fault
+ * on each.  A power of two, at most a page table; 0 or 1 disables it.
+ */
+static unsigned long fault_around_pages __read_mostly = 16;
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_pages_get(void *data, u64 *val)
+{
+	*val = fault_around_pages;
+	return 0;
+}
+
+static int fault_around_pages_set(void *data, u64 val)
+{
+	if (val > PTRS_PER_PTE)
+		return -EINVAL;
+	fault_around_pages = val ? rounddown_pow_of_two(val) : 0;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_pages_fops,
+		fault_around_pages_get, fault_around_pages_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	if (!debugfs_create_file("fault_around_pages", 0644, NULL, NULL,
+				 &fault_around_pages_fops))
+		printk(KERN_WARNING
+		       "Failed to create fault_around_pages in debugfs\n");
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+/*
+ * Let ->map_pages map the cached pages of the @nr_pages (a power of two,
+ * at least 2) aligned block around @address, within the vma and the page
+ * table @pte (mapping @address, locked) belongs to.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+			    pte_t *pte, pgoff_t pgoff, unsigned int flags,
+			    unsigned long nr_pages)
+{
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK,
+			 vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/* Up to the end of the block, of the page table or of the vma */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+			PTRS_PER_PTE - 1;
+	max_pgoff = min(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1);
+	max_pgoff = min(max_pgoff, pgoff + nr_pages - 1);
+
+	/* Skip the ptes already populated */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pgoff = pgoff;
+	vmf.flags = flags;
+	vmf.page = NULL;
+	vmf.max_pgoff = max_pgoff;
+	vmf.pte = pte;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -3147,8 +3246,30 @@ static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 {
 	pgoff_t pgoff = (((address & PAGE_MASK)
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	unsigned long nr_pages;
+	spinlock_t *ptl;
+	int mapped;
 
 	pte_unmap(page_table);
+
+	/*
+	 * On a read fault, first map whatever is already cached around
+	 * the address: if that includes the faulting page, we are done
+	 * without going through ->fault.  The debugfs knob may change under
+	 * us, so read it only once.
+	 */
+	nr_pages = ACCESS_ONCE(fault_around_pages);
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    nr_pages > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags,
+				nr_pages);
+		mapped = !pte_same(*page_table, orig_pte);
+		pte_unmap_unlock(page_table, ptl);
+		if (mapped)
+			return 0;
+	}
+
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
@@ -12,11 +12,14 @@
 #include <linux/kmemleak.h>
 
 static void __meminit
-__init_page_cgroup(struct page_cgroup *pc, unsigned long pfn)
+__init_page_cgroup(struct page_cgroup *pc, unsigned long id)
 {
+	/* Enough space left in pc->flags to store page_cgroup array IDs? */
+	BUILD_BUG_ON(PCG_ARRAYID_WIDTH > BITS_PER_LONG - NR_PCG_FLAGS);
+
 	pc->flags = 0;
+	set_page_cgroup_array_id(pc, id);
 	pc->mem_cgroup = NULL;
-	pc->page = pfn_to_page(pfn);
 	INIT_LIST_HEAD(&pc->lru);
 }
 static unsigned long total_usage;
@@ -43,6 +46,14 @@ struct page_cgroup *lookup_page_cgroup(struct page *page)
 	return base + offset;
 }
 
+struct page *lookup_cgroup_page(struct page_cgroup *pc)
+{
+	pg_data_t *pgdat = NODE_DATA(page_cgroup_array_id(pc));
+
+	return pfn_to_page(pgdat->node_start_pfn +
+			   (pc - pgdat->node_page_cgroup));
+}
+
 static int __init alloc_node_page_cgroup(int nid)
 {
 	struct page_cgroup *base, *pc;
@@ -63,7 +74,7 @@ static int __init alloc_node_page_cgroup(int nid)
 		return -ENOMEM;
 	for (index = 0; index < nr_pages; index++) {
 		pc = base + index;
-		__init_page_cgroup(pc, start_pfn + index);
+		__init_page_cgroup(pc, nid);
 	}
 	NODE_DATA(nid)->node_page_cgroup = base;
 	total_usage += table_size;
@@ -105,6 +116,14 @@ struct page_cgroup *lookup_page_cgroup(struct page *page)
 	return section->page_cgroup + pfn;
 }
 
+struct page *lookup_cgroup_page(struct page_cgroup *pc)
+{
+	struct mem_section *section;
+
+	section = __nr_to_section(page_cgroup_array_id(pc));
+	return pfn_to_page(pc - section->page_cgroup);
+}
+
 /* __alloc_bootmem...() is protected by !slab_available() */
 static int __init_refok init_section_page_cgroup(unsigned long pfn)
 {
@@ -135,15 +154,10 @@ static int __init_refok init_section_page_cgroup(unsigned long pfn)
 		kmemleak_not_leak(base);
 	} else {
 		/*
- 		 * We don't have to allocate page_cgroup again, but
-		 * address of memmap may be changed. So, we have to initialize
-		 * again.
+		 * We don't have to allocate page_cgroup again, and it does
+		 * not depend on the address of the memmap.
 		 */
-		base = section->page_cgroup + pfn;
-		table_size = 0;
-		/* check address of memmap is changed or not. */
-		if (base->page == pfn_to_page(pfn))
-			return 0;
+		return 0;
 	}
 
 	if (!base) {
@@ -153,7 +167,7 @@ static int __init_refok init_section_page_cgroup(unsigned long pfn)
 
 	for (index = 0; index < PAGES_PER_SECTION; index++) {
 		pc = base + index;
-		__init_page_cgroup(pc, pfn + index);
+		__init_page_cgroup(pc, pfn_to_section_nr(pfn));
 	}
 
 	section->page_cgroup = base - pfn;
@@ -251,37 +251,81 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
+/*
+ * Swap readahead by virtual address.
+ *
+ * swapin_readahead() reads the swap slots around the faulting entry,
+ * which avoids seeks but only helps when neighbouring slots hold
+ * related pages.  On a device where seeks are free, like zram, they
+ * mostly don't, and each page read ahead for nothing costs a
+ * decompression and a page of memory.  swapin_readahead_vma() instead
+ * reads the swap entries of the ptes around the faulting address,
+ * wherever they are in the swap area.
+ *
+ * The window of each vma adapts to how many of the pages it read ahead
+ * got used: vma->swap_readahead_info holds the page address of the
+ * last fault, the window used for it and the readahead hits since.
+ */
+#define SWAP_RA_HITS_BITS	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_HITS_BITS) - 1)
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN_MAX		32
+
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_HITS_BITS)
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_VAL(addr, win, hits)	\
+	(((addr) & PAGE_MASK) | ((win) << SWAP_RA_HITS_BITS) | (hits))
+
+static inline void swap_ra_hit(struct vm_area_struct *vma)
+{
+	unsigned long ra_val = atomic_long_read(&vma->swap_readahead_info);
+
+	if (SWAP_RA_HITS(ra_val) < SWAP_RA_HITS_MASK)
+		atomic_long_set(&vma->swap_readahead_info, ra_val + 1);
+}
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
+ *
+ * @vma is the vma faulting on @entry at @addr, or NULL: it is used to
+ * account hits on pages read ahead.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry,
+			       struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma)
+				swap_ra_hit(vma);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-/* 
- * Locate a page of swap in physical memory, reserving swap cache space
- * and reading the disk if it is not already cached.
- * A failure return means that either the page allocation failed or that
- * the swap entry is no longer in use.
+/*
+ * Like read_swap_cache_async(), also telling in *@new whether the page
+ * had to be read from swap.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, int *new)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new = 0;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -332,6 +376,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new = 1;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -349,6 +394,42 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/* 
+ * Locate a page of swap in physical memory, reserving swap cache space
+ * and reading the disk if it is not already cached.
+ * A failure return means that either the page allocation failed or that
+ * the swap entry is no longer in use.
+ */
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	int new;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &new);
+}
+
+/*
+ * Start reading ahead @entry: the page is marked so that a later hit on
+ * it in lookup_swap_cache() can be counted.  Returns 0 if the page
+ * could not be allocated or the entry is no longer in use.
+ */
+static int swap_readahead_page(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	int new;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr, &new);
+	if (!page)
+		return 0;
+	if (new) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+	return 1;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -376,6 +457,8 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	unsigned long offset;
 	unsigned long end_offset;
 
+	count_vm_event(SWAP_RA_MISS);
+
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
 	 * Adjust starting address by readbehind (for NUMA interleave case)?
@@ -385,13 +468,127 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 */
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		if (offset == swp_offset(entry)) {
+			page = read_swap_cache_async(entry, gfp_mask,
+						     vma, addr);
+			if (!page)
+				break;
+			page_cache_release(page);
+			continue;
+		}
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (!swap_readahead_page(swp_entry(swp_type(entry), offset),
+					 gfp_mask, vma, addr))
 			break;
-		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * Number of pages to read around the next fault of a vma: grow the
+ * window while the pages read ahead get used, fall back to the faulting
+ * page alone when they don't, unless the faults are sequential.  Don't
+ * shrink it faster than by half at a time.
+ */
+static unsigned int swap_ra_window(unsigned long fpfn, unsigned long prev_pfn,
+				   unsigned int hits, unsigned int prev_win,
+				   unsigned int max_win)
+{
+	unsigned int win;
+
+	if (hits) {
+		win = 4;
+		while (win < hits + 2)
+			win <<= 1;
+	} else if (fpfn == prev_pfn + 1 || fpfn + 1 == prev_pfn) {
+		win = 2;
+	} else {
+		win = 1;
+	}
+
+	win = max(win, prev_win / 2);
+	return min(win, max_win);
+}
+
+/**
+ * swapin_readahead_vma - swap in pages of a vma in hope we need them soon
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: faulting address
+ * @pmd: pmd mapping @addr
+ *
+ * Returns the struct page for entry and addr, after queueing swapin.
+ *
+ * If the swap area of @entry was enabled with SWAP_FLAG_VMA_RA, read
+ * ahead the swapped out pages mapped next to @addr, in the direction
+ * of the previous faults, else fall back to swapin_readahead().
+ *
+ * Caller must hold down_read on the vma->vm_mm, and must not hold the
+ * pte mapped.
+ */
+struct page *swapin_readahead_vma(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	pte_t ptes[SWAP_RA_WIN_MAX], *pte;
+	unsigned long ra_val, faddr = addr & PAGE_MASK;
+	unsigned long fpfn, prev_pfn, start, end, pfn;
+	unsigned int win, max_win, i;
+	swp_entry_t ra_entry;
+
+	if (!swap_readahead_by_vma(entry))
+		return swapin_readahead(entry, gfp_mask, vma, addr);
+
+	count_vm_event(SWAP_RA_MISS);
+
+	max_win = page_cluster < ilog2(SWAP_RA_WIN_MAX) ?
+			1 << page_cluster : SWAP_RA_WIN_MAX;
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	fpfn = faddr >> PAGE_SHIFT;
+	prev_pfn = SWAP_RA_ADDR(ra_val) >> PAGE_SHIFT;
+	win = swap_ra_window(fpfn, prev_pfn, SWAP_RA_HITS(ra_val),
+			     SWAP_RA_WIN(ra_val), max_win);
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(faddr, win, 0));
+	if (win <= 1)
+		goto out;
+
+	/* Read forward, backward or around, as the faults go */
+	if (fpfn == prev_pfn + 1)
+		start = fpfn;
+	else if (fpfn + 1 == prev_pfn)
+		start = fpfn - min(fpfn, (unsigned long)win - 1);
+	else
+		start = fpfn - min(fpfn, (unsigned long)win / 2);
+
+	/* Stay within the vma and the page table of the fault */
+	start = max(start, max(vma->vm_start, faddr & PMD_MASK) >> PAGE_SHIFT);
+	end = min(start + win, pmd_addr_end(faddr, vma->vm_end) >> PAGE_SHIFT);
+
+	/*
+	 * The ptes are copied without the pte lock: an entry which goes
+	 * away meanwhile is caught by swapcache_prepare().
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < end - start; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0, pfn = start; pfn < end; i++, pfn++) {
+		if (pfn == fpfn)
+			continue;
+		if (pte_none(ptes[i]) || pte_present(ptes[i]) ||
+		    pte_file(ptes[i]))
+			continue;
+		ra_entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(ra_entry)))
+			continue;
+		swap_readahead_page(ra_entry, gfp_mask, vma,
+				    pfn << PAGE_SHIFT);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+out:
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
@@ -2050,6 +2050,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 		if (discard_swap(p) == 0 && (swap_flags & SWAP_FLAG_DISCARD))
 			p->flags |= SWP_DISCARDABLE;
 	}
+	if (swap_flags & SWAP_FLAG_VMA_RA)
+		p->flags |= SWP_VMA_RA;
 
 	mutex_lock(&swapon_mutex);
 	spin_lock(&swap_lock);
@@ -2064,11 +2066,12 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	total_swap_pages += nr_good_pages;
 
 	printk(KERN_INFO "Adding %uk swap on %s.  "
-			"Priority:%d extents:%d across:%lluk %s%s\n",
+			"Priority:%d extents:%d across:%lluk %s%s%s\n",
 		nr_good_pages<<(PAGE_SHIFT-10), name, p->prio,
 		nr_extents, (unsigned long long)span<<(PAGE_SHIFT-10),
 		(p->flags & SWP_SOLIDSTATE) ? "SS" : "",
-		(p->flags & SWP_DISCARDABLE) ? "D" : "");
+		(p->flags & SWP_DISCARDABLE) ? "D" : "",
+		(p->flags & SWP_VMA_RA) ? "V" : "");
 
 	/* insert swap space into swap_list: */
 	prev = -1;
@@ -2295,6 +2298,15 @@ int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 	return nr_pages? ++nr_pages: 0;
 }
 
+/*
+ * Does the swap area of @entry want swapin readahead by virtual address
+ * rather than by swap offset?
+ */
+int swap_readahead_by_vma(swp_entry_t entry)
+{
+	return swap_info[swp_type(entry)]->flags & SWP_VMA_RA;
+}
+
 /*
  * add_swap_count_continuation - called when a swap count is duplicated
  * beyond SWAP_MAP_MAX, it allocates a new page and links that to the entry's
@@ -40,6 +40,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -161,6 +162,11 @@ static unsigned long zone_nr_lru_pages(struct zone *zone,
 void register_shrinker(struct shrinker *shrinker)
 {
 	shrinker->nr = 0;
+	shrinker->stalled = 0;
+	shrinker->nr_calls = 0;
+	shrinker->nr_freed = 0;
+	shrinker->nr_skipped = 0;
+	shrinker->time_ns = 0;
 	down_write(&shrinker_rwsem);
 	list_add_tail(&shrinker->list, &shrinker_list);
 	up_write(&shrinker_rwsem);
@@ -178,7 +184,76 @@ void unregister_shrinker(struct shrinker *shrinker)
 }
 EXPORT_SYMBOL(unregister_shrinker);
 
-#define SHRINK_BATCH 128
+/* shrinker->time_ns is 64 bit: do not let it tear on 32 bit machines */
+static DEFINE_SPINLOCK(shrinker_stat64_lock);
+
+static void shrinker_add_time(struct shrinker *shrinker, u64 ns)
+{
+	spin_lock(&shrinker_stat64_lock);
+	shrinker->time_ns += ns;
+	spin_unlock(&shrinker_stat64_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+#include <linux/debugfs.h>
+#include <linux/kallsyms.h>
+#include <linux/seq_file.h>
+
+static u64 shrinker_time(struct shrinker *shrinker)
+{
+	u64 ns;
+
+	spin_lock(&shrinker_stat64_lock);
+	ns = shrinker->time_ns;
+	spin_unlock(&shrinker_stat64_lock);
+	return ns;
+}
+
+static int shrinker_debug_show(struct seq_file *m, void *v)
+{
+	struct shrinker *shrinker;
+
+	seq_printf(m, "%-40s %5s %6s %10s %10s %10s %12s\n", "shrinker",
+		   "seeks", "batch", "calls", "freed", "skipped", "time_us");
+	down_read(&shrinker_rwsem);
+	list_for_each_entry(shrinker, &shrinker_list, list) {
+		char name[KSYM_SYMBOL_LEN];
+
+		sprint_symbol(name, (unsigned long)shrinker->shrink);
+		seq_printf(m, "%-40s %5d %6ld %10lu %10lu %10lu %12llu\n",
+			   name, shrinker->seeks,
+			   shrinker->batch ? shrinker->batch : SHRINK_BATCH,
+			   shrinker->nr_calls, shrinker->nr_freed,
+			   shrinker->nr_skipped,
+			   div_u64(shrinker_time(shrinker), NSEC_PER_USEC));
+	}
+	up_read(&shrinker_rwsem);
+	return 0;
+}
+
+static int shrinker_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, shrinker_debug_show, NULL);
+}
+
+static const struct file_operations shrinker_debug_fops = {
+	.open		= shrinker_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init shrinker_debug_init(void)
+{
+	if (!debugfs_create_file("shrinkers", 0444, NULL, NULL,
+				 &shrinker_debug_fops))
+		printk(KERN_WARNING
+		       "Failed to create shrinkers in debugfs\n");
+	return 0;
+}
+late_initcall(shrinker_debug_init);
+#endif
+
 /*
  * Call the shrink functions to age shrinkable caches
  *
@@ -196,6 +271,10 @@ EXPORT_SYMBOL(unregister_shrinker);
  * are eligible for the caller's allocation attempt.  It is used for balancing
  * slab reclaim versus page reclaim.
  *
+ * A shrinker whose last scan freed nothing is not scanned again until the
+ * size of its cache changes: its objects are most likely all in use, and
+ * pressure on it would only accumulate to be spent later in vain.
+ *
  * Returns the number of slab objects which we shrunk.
  */
 unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
@@ -214,8 +293,20 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		unsigned long long delta;
 		unsigned long total_scan;
 		unsigned long max_pass;
+		long batch_size = shrinker->batch ? shrinker->batch
+						  : SHRINK_BATCH;
 
 		max_pass = (*shrinker->shrink)(shrinker, 0, gfp_mask);
+		if (!max_pass)
+			continue;
+		if (shrinker->stalled) {
+			if (max_pass == shrinker->stalled) {
+				shrinker->nr_skipped++;
+				continue;
+			}
+			shrinker->stalled = 0;
+		}
+
 		delta = (4 * scanned) / shrinker->seeks;
 		delta *= max_pass;
 		do_div(delta, lru_pages + 1);
@@ -238,18 +329,34 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		total_scan = shrinker->nr;
 		shrinker->nr = 0;
 
-		while (total_scan >= SHRINK_BATCH) {
-			long this_scan = SHRINK_BATCH;
+		/*
+		 * A cache smaller than a batch is still scanned once enough
+		 * pressure has built up to scan all of it.
+		 */
+		while (total_scan >= batch_size || total_scan >= max_pass) {
+			long this_scan = min_t(long, batch_size, total_scan);
 			int shrink_ret;
 			int nr_before;
+			ktime_t start;
 
 			nr_before = (*shrinker->shrink)(shrinker, 0, gfp_mask);
+			start = ktime_get();
 			shrink_ret = (*shrinker->shrink)(shrinker, this_scan,
 								gfp_mask);
+			shrinker_add_time(shrinker,
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+			shrinker->nr_calls++;
 			if (shrink_ret == -1)
 				break;
-			if (shrink_ret < nr_before)
+			if (shrink_ret < nr_before) {
 				ret += nr_before - shrink_ret;
+				shrinker->nr_freed += nr_before - shrink_ret;
+			} else if (nr_before) {
+				/* forget the pressure, it was all in vain */
+				shrinker->stalled = shrink_ret;
+				total_scan = 0;
+				break;
+			}
 			count_vm_events(SLABS_SCANNED, this_scan);
 			total_scan -= this_scan;
 
@@ -1678,8 +1785,21 @@ out:
 	}
 }
 
-static void set_lumpy_reclaim_mode(int priority, struct scan_control *sc)
+static void set_lumpy_reclaim_mode(int priority, struct zone *zone,
+				   struct scan_control *sc)
 {
+#ifdef CONFIG_COMPACTION
+	/*
+	 * kswapd leaves contiguity to kcompactd, see zone_balanced(), and
+	 * only needs to reclaim the order-0 pages compaction works with.
+	 * Unless the last compaction of the zone failed: then lumpy reclaim
+	 * is all there is to produce high-order pages.
+	 */
+	if (current_is_kswapd() && !zone->compact_defer_shift) {
+		sc->lumpy_reclaim_mode = 0;
+		return;
+	}
+#endif
 	/*
 	 * If we need a large contiguous chunk of memory, or have
 	 * trouble getting a small set of contiguous pages, we
@@ -1707,7 +1827,7 @@ static void shrink_zone(int priority, struct zone *zone,
 
 	get_scan_count(zone, sc, nr, priority);
 
-	set_lumpy_reclaim_mode(priority, sc);
+	set_lumpy_reclaim_mode(priority, zone, sc);
 
 	while (nr[LRU_INACTIVE_ANON] || nr[LRU_ACTIVE_FILE] ||
 					nr[LRU_INACTIVE_FILE]) {
@@ -2023,6 +2143,32 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 }
 #endif
 
+/*
+ * A zone is balanced for kswapd when it meets the watermark at the order
+ * kswapd was woken for.  If it only lacks contiguous free memory, kswapd
+ * hands the zone over to kcompactd rather than reclaiming more of it,
+ * unless compaction of the zone is deferred after failing.  Without
+ * @compact, only tell whether it would be handed over.
+ */
+static int zone_balanced(struct zone *zone, int order, unsigned long mark,
+			 int classzone_idx, bool compact)
+{
+	if (zone_watermark_ok_safe(zone, order, mark, classzone_idx, 0))
+		return 1;
+
+	if (!order || !zone_watermark_ok_safe(zone, 0, mark + (2UL << order),
+					      classzone_idx, 0) ||
+	    !compaction_suitable(zone, order))
+		return 0;
+
+	if (!compact)
+		return !compaction_defer_pending(zone);
+	if (compaction_deferred(zone))
+		return 0;
+	wakeup_kcompactd(zone->zone_pgdat, order);
+	return 1;
+}
+
 /* is kswapd sleeping prematurely? */
 static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 {
@@ -2032,7 +2178,10 @@ static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 	if (remaining)
 		return 1;
 
-	/* If after HZ/10, a zone is below the high mark, it's premature */
+	/*
+	 * If after HZ/10, a zone is below the high mark and not left to
+	 * kcompactd, it's premature
+	 */
 	for (i = 0; i < pgdat->nr_zones; i++) {
 		struct zone *zone = pgdat->node_zones + i;
 
@@ -2042,8 +2191,8 @@ static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 		if (zone->all_unreclaimable)
 			continue;
 
-		if (!zone_watermark_ok_safe(zone, order, high_wmark_pages(zone),
-								0, 0))
+		if (!zone_balanced(zone, order, high_wmark_pages(zone), 0,
+				   false))
 			return 1;
 	}
 
@@ -2139,8 +2288,8 @@ loop_again:
 				shrink_active_list(SWAP_CLUSTER_MAX, zone,
 							&sc, priority, 0);
 
-			if (!zone_watermark_ok_safe(zone, order,
-					high_wmark_pages(zone), 0, 0)) {
+			if (!zone_balanced(zone, order,
+					high_wmark_pages(zone), 0, true)) {
 				end_zone = i;
 				break;
 			}
@@ -2167,6 +2316,7 @@ loop_again:
 			struct zone *zone = pgdat->node_zones + i;
 			int nr_slab;
 			int nid, zid;
+			unsigned long nr_soft_reclaimed;
 
 			if (!populated_zone(zone))
 				continue;
@@ -2181,16 +2331,22 @@ loop_again:
 			nid = pgdat->node_id;
 			zid = zone_idx(zone);
 			/*
-			 * Call soft limit reclaim before calling shrink_zone.
-			 * For now we ignore the return value
+			 * Call soft limit reclaim before calling shrink_zone,
+			 * and leave the groups within their soft limit alone
+			 * if reclaiming from the others was enough.
 			 */
-			mem_cgroup_soft_limit_reclaim(zone, order, sc.gfp_mask,
-							nid, zid);
+			nr_soft_reclaimed = mem_cgroup_soft_limit_reclaim(zone,
+						order, sc.gfp_mask, nid, zid);
+			sc.nr_reclaimed += nr_soft_reclaimed;
 			/*
 			 * We put equal pressure on every zone, unless one
 			 * zone has way too many pages free already.
 			 */
-			if (!zone_watermark_ok_safe(zone, order,
+			if ((!nr_soft_reclaimed ||
+			     !zone_balanced(zone, order,
+					    high_wmark_pages(zone), end_zone,
+					    true)) &&
+			    !zone_watermark_ok_safe(zone, order,
 					8*high_wmark_pages(zone), end_zone, 0))
 				shrink_zone(priority, zone, &sc);
 			reclaim_state->reclaimed_slab = 0;
@@ -2211,8 +2367,9 @@ loop_again:
 			    total_scanned > sc.nr_reclaimed + sc.nr_reclaimed / 2)
 				sc.may_writepage = 1;
 
-			if (!zone_watermark_ok_safe(zone, order,
-					high_wmark_pages(zone), end_zone, 0)) {
+			if (!zone_balanced(zone, order,
+					high_wmark_pages(zone), end_zone,
+					true)) {
 				all_zones_ok = 0;
 				/*
 				 * We are still under min water mark.  This